@@ -9,6 +9,9 @@
 #include <tuple>
 #include <vector>
 #include <limits>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
 #include "cfg/containers.h"
 #include "cfg/helpers_runtime.h"
 
@@ -51,6 +54,218 @@ protected:
 
 
 
+/**
+ * @brief Arena-backed AST. Nodes are stored contiguously and linked by indices, children of each node occupy a contiguous range of the edges array (CSR).
+ * Reduce builds the node in place without copying subtrees. Traversal is performed over lightweight views which mimic the TreeNode interface
+ * @tparam VStr Variable string class
+ * @tparam TIndex Node index type
+ */
+template<class VStr, class TIndex = std::uint32_t>
+class FlatTree
+{
+public:
+    using index_type = TIndex;
+    static constexpr TIndex npos = std::numeric_limits<TIndex>::max();
+
+    struct Node
+    {
+        VStr name;
+        VStr value; // Token value
+        TIndex parent;
+        TIndex first; // First child position in the edges array
+        TIndex count; // Number of children
+    };
+
+    class NodeView;
+
+    /**
+     * @brief Range of child nodes, mimics std::vector<TreeNode>
+     */
+    class ChildrenView
+    {
+    protected:
+        const FlatTree* tree;
+        const TIndex* _begin;
+        const TIndex* _end;
+
+    public:
+        class iterator
+        {
+        protected:
+            const FlatTree* tree;
+            const TIndex* it;
+
+        public:
+            iterator(const FlatTree* t, const TIndex* i) : tree(t), it(i) {}
+
+            NodeView operator*() const { return tree->view(*it); }
+
+            iterator& operator++() { ++it; return *this; }
+
+            bool operator==(const iterator& rhs) const { return it == rhs.it; }
+        };
+
+        ChildrenView(const FlatTree* t, const TIndex* b, const TIndex* e) : tree(t), _begin(b), _end(e) {}
+
+        [[nodiscard]] std::size_t size() const { return _end - _begin; }
+
+        [[nodiscard]] bool empty() const { return _begin == _end; }
+
+        NodeView operator[](std::size_t i) const { return tree->view(_begin[i]); }
+
+        NodeView back() const { return tree->view(*(_end - 1)); }
+
+        iterator begin() const { return iterator(tree, _begin); }
+
+        iterator end() const { return iterator(tree, _end); }
+    };
+
+    /**
+     * @brief Read-only node handle with TreeNode-compatible fields
+     */
+    class NodeView
+    {
+    public:
+        const VStr& name;
+        const VStr& value;
+        ChildrenView nodes;
+        TIndex index;
+
+        NodeView(const VStr& n, const VStr& v, const ChildrenView& c, TIndex i) : name(n), value(v), nodes(c), index(i) {}
+
+        void traverse(auto func) const { do_traverse(func, 0); }
+
+    protected:
+        void do_traverse(auto func, std::size_t depth) const
+        {
+            func(*this, depth);
+            for (const auto& node : nodes) node.do_traverse(func, depth + 1);
+        }
+    };
+
+protected:
+    std::vector<Node> arena; // arena[0] is the root
+    std::vector<TIndex> edges; // Children ranges of the reduced nodes
+    std::vector<TIndex> forest; // Children of the root, which are not reduced yet
+
+public:
+    FlatTree() : arena{Node{VStr(), VStr(), npos, 0, 0}}, edges(), forest() {}
+
+    /**
+     * @brief Reserve storage for the expected number of nodes
+     */
+    void reserve(std::size_t n)
+    {
+        arena.reserve(n + 1);
+        edges.reserve(n);
+    }
+
+    /**
+     * @brief Create a new node from the last n root children and append it to the root
+     * @param name Node name
+     * @param n Number of the root children to adopt
+     * @param value Concatenated token values of the reduced symbols
+     */
+    template<class TStr>
+    void reduce(const TStr& name, std::size_t n, VStr&& value)
+    {
+        const auto id = static_cast<TIndex>(arena.size());
+        const auto first = static_cast<TIndex>(edges.size());
+        edges.insert(edges.end(), forest.rbegin(), forest.rbegin() + n); // Same children order as in the TreeNode reduce
+        forest.erase(forest.end() - n, forest.end());
+        for (std::size_t i = first; i < edges.size(); i++)
+            arena[edges[i]].parent = id;
+
+        arena.push_back(Node{VStr(name), std::move(value), 0, first, static_cast<TIndex>(n)});
+        forest.push_back(id);
+    }
+
+    [[nodiscard]] std::size_t size() const { return arena.size(); }
+
+    [[nodiscard]] const Node& get(TIndex i) const { return arena[i]; }
+
+    [[nodiscard]] NodeView view(TIndex i) const
+    {
+        const Node& node = arena[i];
+        if (i == 0)
+            return NodeView(node.name, node.value, ChildrenView(this, forest.data(), forest.data() + forest.size()), i);
+        return NodeView(node.name, node.value, ChildrenView(this, edges.data() + node.first, edges.data() + node.first + node.count), i);
+    }
+
+    [[nodiscard]] NodeView root() const { return view(0); }
+
+    void traverse(auto func) const { root().traverse(func); }
+};
+
+
+template<class T>
+struct is_flat_tree : std::false_type {};
+
+template<class VStr, class TIndex>
+struct is_flat_tree<FlatTree<VStr, TIndex>> : std::true_type {};
+
+template<class T>
+constexpr bool is_flat_tree_v = is_flat_tree<std::remove_cvref_t<T>>::value;
+
+
+/**
+ * @brief Tree builder which ignores all parser events. The parser only recognizes the input and allocates no nodes
+ */
+class NullTree
+{
+public:
+    template<class TToken>
+    void on_shift(const TToken&) {}
+
+    template<class TType, class TWindow>
+    void on_reduce(const TType&, std::size_t, const TWindow&) {}
+};
+
+
+/**
+ * @brief Tree builder which forwards the parser events to the user callbacks, e.g. to fold the reductions without building a tree.
+ * Each stack symbol is either a shifted token or a reduced nterm, so the callbacks may keep their own stack of values
+ * @tparam OnShift Callback, which receives each shifted token
+ * @tparam OnReduce Callback, which receives the nterm type, the nterm id and the window of the reduced stack symbols
+ */
+template<class OnShift, class OnReduce>
+class CallbackTree
+{
+public:
+    OnShift shift_fn;
+    OnReduce reduce_fn;
+
+    CallbackTree(OnShift on_shift, OnReduce on_reduce) : shift_fn(std::move(on_shift)), reduce_fn(std::move(on_reduce)) {}
+
+    template<class TToken>
+    void on_shift(const TToken& token) { shift_fn(token); }
+
+    template<class TType, class TWindow>
+    void on_reduce(const TType& type, std::size_t nterm_id, const TWindow& children) { reduce_fn(type, nterm_id, children); }
+};
+
+
+template<class OnShift, class OnReduce>
+auto make_callback_tree(OnShift on_shift, OnReduce on_reduce) { return CallbackTree<OnShift, OnReduce>(std::move(on_shift), std::move(on_reduce)); }
+
+
+/**
+ * @brief Tree classes which receive the shift and reduce events instead of storing the nodes
+ */
+template<class T>
+struct is_tree_builder : std::false_type {};
+
+template<>
+struct is_tree_builder<NullTree> : std::true_type {};
+
+template<class OnShift, class OnReduce>
+struct is_tree_builder<CallbackTree<OnShift, OnReduce>> : std::true_type {};
+
+template<class T>
+constexpr bool is_tree_builder_v = is_tree_builder<std::remove_cvref_t<T>>::value;
+
+
+
  /**
   * @brief Base nonterminal class
   * @tparam CStr Const string class
@@ -0,0 +1,212 @@
+#ifndef SUPERCFG_BATCH_H
+#define SUPERCFG_BATCH_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * @brief Work queues of the batch workers. Each worker takes the items from the back of its own queue, idle workers steal from the front of the other queues
+ */
+class WorkStealingQueues
+{
+protected:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<std::size_t> items;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+
+public:
+    explicit WorkStealingQueues(std::size_t n_workers)
+    {
+        for (std::size_t w = 0; w < std::max<std::size_t>(n_workers, 1); w++)
+            queues.push_back(std::make_unique<Queue>());
+    }
+
+    [[nodiscard]] std::size_t size() const { return queues.size(); }
+
+    /**
+     * @brief Split the items [0, n) into contiguous blocks, one per worker
+     */
+    void fill(std::size_t n)
+    {
+        const std::size_t block = (n + queues.size() - 1) / queues.size();
+        for (std::size_t w = 0; w < queues.size(); w++)
+        {
+            std::lock_guard guard(queues[w]->lock);
+            queues[w]->items.clear();
+            // Reversed, so that the owner processes its block in order
+            for (std::size_t i = std::min(n, (w + 1) * block); i > w * block && i > 0; i--)
+                queues[w]->items.push_back(i - 1);
+        }
+    }
+
+    /**
+     * @brief Get the next item of the worker. Returns false if all queues are empty, items are never added during processing
+     */
+    bool pop(std::size_t worker, std::size_t& item)
+    {
+        {
+            Queue& own = *queues[worker];
+            std::lock_guard guard(own.lock);
+            if (!own.items.empty())
+            {
+                item = own.items.back();
+                own.items.pop_back();
+                return true;
+            }
+        }
+
+        for (std::size_t k = 1; k < queues.size(); k++)
+        {
+            Queue& victim = *queues[(worker + k) % queues.size()];
+            std::lock_guard guard(victim.lock);
+            if (!victim.items.empty())
+            {
+                item = victim.items.front();
+                victim.items.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+
+/**
+ * @brief Parses many independent inputs over a pool of workers. The lexer and the parser are shared read-only, each worker reuses its own parse session.
+ * Worker threads are started once and wait for the next batch, the calling thread is the first worker
+ * @tparam Tree Parser tree node class
+ * @tparam TLexer Lexer class
+ * @tparam TParser SRParser class
+ */
+template<class Tree, class TLexer, class TParser>
+class BatchParser
+{
+public:
+    struct Result
+    {
+        bool ok = false;
+        Tree tree;
+    };
+
+    const TLexer& lexer;
+    const TParser& parser;
+    std::vector<typename TParser::ParseSession> sessions; // Session of each worker, kept between the batches
+    WorkStealingQueues queues;
+
+protected:
+    std::vector<std::thread> threads; // Workers [1, n)
+    std::mutex lock;
+    std::condition_variable wake, done;
+    std::function<void(std::size_t)> job; // Work of the current batch
+    std::size_t batch_id = 0; // Incremented on each batch
+    std::size_t running = 0; // Workers which have not finished the current batch
+    bool stop = false;
+
+public:
+    BatchParser(const TLexer& lex, const TParser& p, std::size_t n_workers) : lexer(lex), parser(p), queues(n_workers)
+    {
+        for (std::size_t w = 0; w < queues.size(); w++)
+            sessions.push_back(parser.make_session());
+        for (std::size_t w = 1; w < queues.size(); w++)
+            threads.emplace_back([this, w]{ worker_loop(w); });
+    }
+
+    // Workers reference the pool
+    BatchParser(const BatchParser&) = delete;
+    BatchParser& operator=(const BatchParser&) = delete;
+
+    ~BatchParser()
+    {
+        {
+            std::lock_guard guard(lock);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    [[nodiscard]] std::size_t workers() const { return queues.size(); }
+
+    /**
+     * @brief Tokenize and parse each input
+     * @param root Rules starting point
+     * @param inputs Random access range of the input texts
+     * @param results Status and tree of each input, in the inputs order
+     */
+    template<class RootSymbol, class InputRange>
+    void parse_batch(const RootSymbol& root, const InputRange& inputs, std::vector<Result>& results)
+    {
+        const std::size_t n = std::size(inputs);
+        results.clear();
+        results.resize(n);
+        queues.fill(n);
+
+        auto work = [&](std::size_t worker){
+            std::size_t i;
+            while (queues.pop(worker, i))
+            {
+                bool ok;
+                auto tokens = lexer.run(std::begin(inputs)[i], ok);
+                if (ok) ok = parser.run(results[i].tree, root, tokens, sessions[worker]);
+                results[i].ok = ok;
+            }
+        };
+
+        {
+            std::lock_guard guard(lock);
+            job = work;
+            running = threads.size();
+            batch_id++;
+        }
+        wake.notify_all();
+        work(0);
+
+        std::unique_lock guard(lock);
+        done.wait(guard, [&]{ return running == 0; });
+        job = nullptr;
+    }
+
+protected:
+    void worker_loop(std::size_t worker)
+    {
+        std::size_t seen = 0;
+        std::unique_lock guard(lock);
+        while (true)
+        {
+            wake.wait(guard, [&]{ return stop || batch_id != seen; });
+            if (stop) return;
+            seen = batch_id;
+
+            guard.unlock();
+            job(worker);
+            guard.lock();
+            if (--running == 0) done.notify_one();
+        }
+    }
+};
+
+
+/**
+ * @brief Create the batch parser over an existing lexer and parser, which should outlive it
+ * @param n_workers Number of workers, all hardware threads by default
+ */
+template<class Tree, class TLexer, class TParser>
+auto make_batch_parser(const TLexer& lexer, const TParser& parser, std::size_t n_workers = std::thread::hardware_concurrency())
+{
+    return BatchParser<Tree, TLexer, TParser>(lexer, parser, n_workers);
+}
+
+
+#endif //SUPERCFG_BATCH_H
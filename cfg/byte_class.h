@@ -0,0 +1,131 @@
+#ifndef SUPERCFG_BYTE_CLASS_H
+#define SUPERCFG_BYTE_CLASS_H
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+/**
+ * @brief Classes of the bytes which are always lexed as single-character terminals, e.g. the characters of a TermsRange.
+ * Bytes of one class produce tokens with the same value, runs of them are measured 32 (AVX2) or 16 (SSE2) bytes at a time against the class ranges
+ * @tparam Value Value of a class (token types)
+ */
+template<class Value>
+class ByteClasses
+{
+public:
+    static constexpr std::uint8_t none = 0; // The byte is handled by the regular lexer path
+    static constexpr std::size_t max_simd_ranges = 8; // Classes with more ranges are scanned through the table
+
+protected:
+    struct Range
+    {
+        std::uint8_t lo, span; // [lo, lo + span]
+    };
+
+    std::array<std::uint8_t, 256> table{}; // Byte -> class
+    std::vector<Value> values; // values[class - 1]
+    std::vector<std::vector<Range>> ranges; // ranges[class - 1], sorted
+
+public:
+    /**
+     * @brief Assign the byte to the class with an equal value, a new class is created if there is none
+     * @param eq Value comparator (lhs, rhs) -> bool
+     */
+    template<class Eq>
+    void add(std::uint8_t byte, const Value& value, Eq&& eq)
+    {
+        std::size_t cls = 0;
+        while (cls < values.size() && !eq(values[cls], value)) cls++;
+        if (cls == values.size())
+        {
+            if (values.size() == 255) return; // Out of class ids, the byte is left to the lexer
+            values.push_back(value);
+        }
+        table[byte] = static_cast<std::uint8_t>(cls + 1);
+    }
+
+    /**
+     * @brief Merge the bytes of each class into ranges. Must be called after all bytes are added
+     */
+    void build()
+    {
+        ranges.assign(values.size(), {});
+        for (std::size_t b = 0; b < 256; b++)
+        {
+            const std::uint8_t cls = table[b];
+            if (cls == none) continue;
+            auto& r = ranges[cls - 1];
+            if (!r.empty() && r.back().lo + r.back().span + 1 == b) r.back().span++;
+            else r.push_back(Range{static_cast<std::uint8_t>(b), 0});
+        }
+    }
+
+    [[nodiscard]] bool empty() const { return values.empty(); }
+
+    [[nodiscard]] std::size_t size() const { return values.size(); } // Number of classes
+
+    std::uint8_t operator[](std::uint8_t byte) const { return table[byte]; }
+
+    const Value& value(std::uint8_t cls) const { return values[cls - 1]; }
+
+    /**
+     * @brief Get the length of the leading run of class cls bytes in [p, p + n)
+     */
+    [[nodiscard]] std::size_t run(const unsigned char* p, std::size_t n, std::uint8_t cls) const
+    {
+        std::size_t i = 0;
+        [[maybe_unused]] const auto& r = ranges[cls - 1];
+#if defined(__AVX2__)
+        if (r.size() <= max_simd_ranges)
+        {
+            for (; i + 32 <= n; i += 32)
+            {
+                const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+                __m256i in = _mm256_setzero_si256();
+                for (const auto& range : r)
+                {
+                    // Unsigned x - lo <= span
+                    const __m256i span = _mm256_set1_epi8(static_cast<char>(range.span));
+                    const __m256i t = _mm256_sub_epi8(x, _mm256_set1_epi8(static_cast<char>(range.lo)));
+                    in = _mm256_or_si256(in, _mm256_cmpeq_epi8(_mm256_max_epu8(t, span), span));
+                }
+                const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(in));
+                if (mask != 0xFFFFFFFFu) return i + std::countr_one(mask);
+            }
+        }
+#elif defined(__SSE2__)
+        if (r.size() <= max_simd_ranges)
+        {
+            for (; i + 16 <= n; i += 16)
+            {
+                const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                __m128i in = _mm_setzero_si128();
+                for (const auto& range : r)
+                {
+                    const __m128i span = _mm_set1_epi8(static_cast<char>(range.span));
+                    const __m128i t = _mm_sub_epi8(x, _mm_set1_epi8(static_cast<char>(range.lo)));
+                    in = _mm_or_si128(in, _mm_cmpeq_epi8(_mm_max_epu8(t, span), span));
+                }
+                const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(in));
+                if (mask != 0xFFFFu) return i + std::countr_one(mask);
+            }
+        }
+#endif
+        // Tail and the portable path
+        while (i < n && table[p[i]] == cls) i++;
+        return i;
+    }
+};
+
+
+#endif //SUPERCFG_BYTE_CLASS_H
@@ -13,6 +13,8 @@
 #include <limits>
 #include <cstdint>
 #include <memory>
+#include <utility>
+#include <bit>
 
 #include "cfg/common.h"
 #include "cfg/helpers.h"
@@ -317,6 +319,9 @@ public:
         }
     }
 
+    // Move ctor
+    constexpr ConstVec(ConstVec<T>&& rhs) noexcept : _st(std::move(rhs._st)), _n(std::exchange(rhs._n, 0)), _cap(std::exchange(rhs._cap, 0)) {}
+
     // Initialize a singleton
     constexpr explicit ConstVec(const T& elem) : _st(new T[1]), _n(1), _cap(1) { _st[0] = elem; }
 
@@ -413,6 +418,14 @@ public:
         return *this;
     }
 
+    ConstVec<T>& operator=(ConstVec&& rhs) noexcept
+    {
+        _st = std::move(rhs._st);
+        _n = std::exchange(rhs._n, 0);
+        _cap = std::exchange(rhs._cap, 0);
+        return *this;
+    }
+
     ConstVec<T>& operator+=(const T& rhs) // push_back
     {
         _st[_n] = rhs;
@@ -438,4 +451,61 @@ protected:
 
 
 
+/**
+ * @brief Fixed-width set of type indices. Intersection is a word-wise AND and needs no allocation
+ * @tparam N Number of types
+ */
+template<std::size_t N>
+class TypeBitset
+{
+protected:
+    static constexpr std::size_t n_words = N > 0 ? (N + 63) / 64 : 1;
+    std::array<std::uint64_t, n_words> words{};
+
+public:
+    constexpr TypeBitset() = default;
+
+    static constexpr std::size_t capacity() { return N; }
+
+    constexpr void set(std::size_t i) { words[i >> 6] |= std::uint64_t(1) << (i & 63); }
+
+    [[nodiscard]] constexpr bool test(std::size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+
+    [[nodiscard]] constexpr bool empty() const
+    {
+        for (const auto w : words)
+            if (w != 0) return false;
+        return true;
+    }
+
+    [[nodiscard]] constexpr bool intersects(const TypeBitset& rhs) const
+    {
+        for (std::size_t i = 0; i < n_words; i++)
+            if ((words[i] & rhs.words[i]) != 0) return true;
+        return false;
+    }
+
+    [[nodiscard]] constexpr std::size_t count() const
+    {
+        std::size_t n = 0;
+        for (const auto w : words) n += std::popcount(w);
+        return n;
+    }
+
+    constexpr TypeBitset& operator&=(const TypeBitset& rhs)
+    {
+        for (std::size_t i = 0; i < n_words; i++) words[i] &= rhs.words[i];
+        return *this;
+    }
+
+    constexpr TypeBitset& operator|=(const TypeBitset& rhs)
+    {
+        for (std::size_t i = 0; i < n_words; i++) words[i] |= rhs.words[i];
+        return *this;
+    }
+
+    constexpr bool operator==(const TypeBitset& rhs) const = default;
+};
+
+
 #endif //SUPERCFG_CONTAINERS_H
@@ -122,8 +122,8 @@ public:
     /**
      * @brief Consume the next token and perform context analysis. Returns false on ambiguity
      */
-    template<class GSymbol, class SymbolsHT>
-    bool next(const GSymbol& g_symbol, const std::vector<GSymbol>& stack, const SymbolsHT& symbols_ht, auto& prettyprinter)
+    template<class GSymbol, class TStack, class SymbolsHT>
+    bool next(const GSymbol& g_symbol, const TStack& stack, const SymbolsHT& symbols_ht, auto& prettyprinter)
     {
         std::size_t stack_size = stack.size();
         // Visit the explicit type. Note that it may return either an NTerm or
@@ -362,8 +362,8 @@ public:
      * @param def Match candidate rule definition
      * @param stack Stack before the reduction
      */
-    template<class TSymbol, class TRule, class GSymbol>
-    constexpr bool apply_reduce(const TSymbol& match, const TRule& def, const std::vector<GSymbol>& stack, const std::size_t new_stack_size, auto& prettyprinter = NoPrettyPrinter())
+    template<class TSymbol, class TRule, class TStack>
+    constexpr bool apply_reduce(const TSymbol& match, const TRule& def, const TStack& stack, const std::size_t new_stack_size, auto& prettyprinter = NoPrettyPrinter())
     {
         std::size_t stack_size = stack.size();
         //std::size_t reduction_size = std::decay_t<TRule>::size(); // Size of the candidate rule, N symbols will be removed from the end of the stack
@@ -9,6 +9,7 @@
 #include "cfg/preprocess.h"
 #include "cfg/preprocess_factories.h"
 #include "cfg/base.h"
+#include "cfg/containers.h"
 
 namespace cfg_helpers
 {
@@ -328,11 +329,127 @@ namespace cfg_helpers
 template<class NTermsTuple, class MustFollowTuple>
 class FollowSet
 {
+protected:
+    /**
+     * @brief Check if the nterm at i is defined earlier
+     */
+    template<std::size_t i>
+    static constexpr bool is_dup()
+    {
+        return []<std::size_t... J>(std::index_sequence<J...>){
+            return (std::is_same_v<std::tuple_element_t<i, NTermsTuple>, std::tuple_element_t<J, NTermsTuple>> || ... || false);
+        }(std::make_index_sequence<i>{});
+    }
+
 public:
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    /**
+     * @brief Dense id of the nterm. Nterms are numbered in the definition order, duplicates share the first id. npos if the nterm is not defined
+     */
+    template<class TSymbol>
+    static constexpr std::size_t nterm_id()
+    {
+        return []<std::size_t... I>(std::index_sequence<I...>){
+            constexpr std::array<bool, sizeof...(I)> dup{is_dup<I>()...};
+            constexpr std::array<bool, sizeof...(I)> same{std::is_same_v<std::decay_t<TSymbol>, std::tuple_element_t<I, NTermsTuple>>...};
+            std::size_t id = 0;
+            for (std::size_t i = 0; i < sizeof...(I); i++)
+            {
+                if (dup[i]) continue;
+                if (same[i]) return id;
+                id++;
+            }
+            return npos;
+        }(std::make_index_sequence<std::tuple_size_v<NTermsTuple>>{});
+    }
+
+    static constexpr std::size_t n_nterms = []<std::size_t... I>(std::index_sequence<I...>){
+        return (std::size_t(0) + ... + !is_dup<I>());
+    }(std::make_index_sequence<std::tuple_size_v<NTermsTuple>>{});
+
+    using FollowRow = TypeBitset<n_nterms>; // One bit per nterm id
+
     NTermsTuple defs;
     MustFollowTuple follow;
+    std::array<FollowRow, n_nterms> matrix{}; // matrix[match] : nterms in the FOLLOW set of match
+    std::array<FollowRow, n_nterms> ancestors{}; // Nterms which contain the nterm, directly or not
+    std::array<FollowRow, n_nterms> reach{}; // Nterms which may be typed on the token after a token of the nterm type, only built for LA(k)
 
-    constexpr FollowSet(const NTermsTuple& nterms, const MustFollowTuple& follow) : defs(nterms), follow(follow) {}
+    constexpr FollowSet(const NTermsTuple& nterms, const MustFollowTuple& follow) : defs(nterms), follow(follow)
+    {
+        fill_matrix(std::make_index_sequence<std::tuple_size_v<NTermsTuple>>{});
+    }
+
+    /**
+     * @brief Compute the ancestors of each nterm
+     * @param reverse_rules NTerm -> tuple of the nterms where it is present
+     */
+    template<class RRTree>
+    constexpr void close(const RRTree& reverse_rules)
+    {
+        std::array<FollowRow, n_nterms>& parents = ancestors;
+        [&]<std::size_t... I>(std::index_sequence<I...>){
+            ([&]{
+                if constexpr (!is_dup<I>())
+                {
+                    tuple_each(reverse_rules.get(std::get<I>(defs)), [&](std::size_t l, const auto& parent){
+                        constexpr std::size_t id = nterm_id<std::decay_t<decltype(parent)>>();
+                        if constexpr (id != npos) parents[nterm_id<std::tuple_element_t<I, NTermsTuple>>()].set(id);
+                    });
+                }
+            }(), ...);
+        }(std::make_index_sequence<std::tuple_size_v<NTermsTuple>>{});
+
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (std::size_t i = 0; i < n_nterms; i++)
+            {
+                FollowRow row = parents[i];
+                for (std::size_t p = 0; p < n_nterms; p++)
+                    if (parents[i].test(p)) row |= parents[p];
+                changed = changed || !(row == parents[i]);
+                parents[i] = row;
+            }
+        }
+    }
+
+    /**
+     * @brief Build the reach matrix, which links consecutive tokens. A token of the nterm type may be followed by the nterm itself, the nterms of its definition,
+     * and the FOLLOW set of the nterm and its ancestors. Terms of the FOLLOW sets yield the nterms which contain them, as the lexer types the tokens. Should be called after close()
+     * @tparam TDefsTuple Tuple of the rule definitions
+     */
+    template<class TDefsTuple>
+    constexpr void link()
+    {
+        // Nterms of each FOLLOW set, including the terms owners
+        std::array<FollowRow, n_nterms> owners{};
+        [&]<std::size_t... I>(std::index_sequence<I...>){
+            ([&]{
+                if constexpr (!is_dup<I>())
+                {
+                    FollowRow& row = owners[nterm_id<std::tuple_element_t<I, NTermsTuple>>()];
+                    [&]<class... Fs>(const std::tuple<Fs...>*){ (mark_follow<std::decay_t<Fs>, TDefsTuple>(row), ...); }(static_cast<const std::decay_t<std::tuple_element_t<I, MustFollowTuple>>*>(nullptr));
+                }
+            }(), ...);
+        }(std::make_index_sequence<std::tuple_size_v<NTermsTuple>>{});
+
+        [&]<class... Defs>(const std::tuple<Defs...>*){
+            ([&]{
+                constexpr std::size_t id = nterm_id<get_first_t<Defs>>();
+                reach[id].set(id);
+                mark_nterms<std::decay_t<get_second_t<Defs>>>(reach[id]);
+            }(), ...);
+        }(static_cast<const TDefsTuple*>(nullptr));
+
+        for (std::size_t i = 0; i < n_nterms; i++)
+        {
+            reach[i] |= owners[i];
+            for (std::size_t p = 0; p < n_nterms; p++)
+                if (ancestors[i].test(p)) reach[i] |= owners[p];
+        }
+    }
 
     template<class TSymbol>
     constexpr auto get(const TSymbol& symbol) const
@@ -347,6 +464,59 @@ public:
     }
 
 protected:
+    template<std::size_t... I>
+    constexpr void fill_matrix(std::index_sequence<I...> seq)
+    {
+        ([&]{ if constexpr (!is_dup<I>()) fill_row<I>(seq); }(), ...);
+    }
+
+    template<std::size_t row, std::size_t... I>
+    constexpr void fill_row(std::index_sequence<I...>)
+    {
+        using Follow = std::decay_t<std::tuple_element_t<row, MustFollowTuple>>;
+        FollowRow& bits = matrix[nterm_id<std::tuple_element_t<row, NTermsTuple>>()];
+        ([&]{
+            if constexpr (tuple_contains_v<std::tuple_element_t<I, NTermsTuple>, Follow>)
+                bits.set(nterm_id<std::tuple_element_t<I, NTermsTuple>>());
+        }(), ...);
+    }
+
+    /**
+     * @brief Mark the nterms of the definition, without descending into them
+     */
+    template<class TSymbol>
+    static constexpr void mark_nterms(FollowRow& row)
+    {
+        if constexpr (is_operator<TSymbol>())
+            [&]<class... Ts>(const std::tuple<Ts...>*){ (mark_nterms<std::decay_t<Ts>>(row), ...); }(static_cast<const typename TSymbol::term_types_tuple*>(nullptr));
+        else if constexpr (is_nterm<TSymbol>())
+        {
+            constexpr std::size_t id = nterm_id<TSymbol>();
+            if constexpr (id != npos) row.set(id);
+        }
+    }
+
+    /**
+     * @brief Mark a FOLLOW set symbol : an nterm, or the nterms whose definitions contain the term
+     */
+    template<class TSymbol, class TDefsTuple>
+    static constexpr void mark_follow(FollowRow& row)
+    {
+        if constexpr (is_operator<TSymbol>())
+            [&]<class... Ts>(const std::tuple<Ts...>*){ (mark_follow<std::decay_t<Ts>, TDefsTuple>(row), ...); }(static_cast<const typename TSymbol::term_types_tuple*>(nullptr));
+        else if constexpr (is_nterm<TSymbol>())
+            mark_nterms<TSymbol>(row);
+        else
+        {
+            [&]<class... Defs>(const std::tuple<Defs...>*){
+                ([&]{
+                    if constexpr (cfg_helpers::FollowSetFactory::peek_into<TSymbol, std::decay_t<get_second_t<Defs>>>())
+                        row.set(nterm_id<get_first_t<Defs>>());
+                }(), ...);
+            }(static_cast<const TDefsTuple*>(nullptr));
+        }
+    }
+
     template<std::size_t depth, class TSymbol>
     constexpr auto do_get(const TSymbol& symbol) const
     {
@@ -365,17 +535,27 @@ auto follow_set_factory(const RRTree& reverse_rules, const NTermsMap& nterms2def
     auto nterms = nterms2defs.nterms;
     auto factory = cfg_helpers::FollowSetFactory();
     auto follow = factory.follow_set_each_symbol<0>(nterms, reverse_rules, nterms2defs);
-    return FollowSet(nterms, follow);
+    auto set = FollowSet(nterms, follow);
+    set.close(reverse_rules);
+    return set;
 }
 
 
-template<class Follow>
+/**
+ * @brief FOLLOW set lookahead, which prevents partial reductions
+ * @tparam Follow FollowSet class
+ * @tparam K Number of the checked tokens. The types of each token should follow the types of the previous one for the tokens to continue a match (LA(k))
+ */
+template<class Follow, std::size_t K = 1>
 class SimpleLookahead
 {
 protected:
     std::size_t _lookahead_state;
 public:
     Follow follow_set;
+    using FollowRow = typename Follow::FollowRow;
+    static constexpr std::size_t depth = K;
+    static_assert(K > 0, "SimpleLookahead : at least one token should be checked");
 
     constexpr explicit SimpleLookahead(const Follow& follow) : follow_set(follow), _lookahead_state(0) {}
 
@@ -405,6 +585,47 @@ public:
         return follow_set.can_reduce(match, next);
     }
 
+    /**
+     * @brief Dense id of the nterm in the FOLLOW matrix
+     */
+    template<class TSymbol>
+    static constexpr std::size_t nterm_id() { return Follow::template nterm_id<TSymbol>(); }
+
+    /**
+     * @brief Check if a reduction to the nterm with the given id would be partial, next is the output of continuation()
+     */
+    [[nodiscard]] constexpr bool follows(std::size_t match, const FollowRow& next) const { return follow_set.matrix[match].intersects(next); }
+
+    /**
+     * @brief Get the types of the next token which start a possible continuation of the next n tokens (n <= depth).
+     * A type is kept if a kept type of the following token or its ancestor is reachable from it. With n == 1 all types of the token are kept
+     * @param types Callback (std::size_t d, FollowRow& row) which writes the nterm ids of the token types at d
+     */
+    template<class Types>
+    FollowRow continuation(std::size_t n, Types&& types) const
+    {
+        FollowRow next;
+        if (n == 0) return next;
+        types(n - 1, next);
+        for (std::size_t d = n - 1; d-- > 0;)
+        {
+            FollowRow cur, up = next, kept;
+            types(d, cur);
+            if (next.empty())
+            {
+                // Unknown types, the chain starts over
+                next = cur;
+                continue;
+            }
+            for (std::size_t c = 0; c < Follow::n_nterms; c++)
+                if (next.test(c)) up |= follow_set.ancestors[c];
+            for (std::size_t c = 0; c < Follow::n_nterms; c++)
+                if (cur.test(c) && follow_set.reach[c].intersects(up)) kept.set(c);
+            next = kept;
+        }
+        return next;
+    }
+
     template<class VStr>
     void prettyprint() const
     {
@@ -452,13 +673,21 @@ protected:
 };
 
 
-class NoLookahead {};
+class NoLookahead
+{
+public:
+    using FollowRow = std::false_type;
+    static constexpr std::size_t depth = 1;
+};
 
 
-template<class RRTree, class NTermsMap>
+template<std::size_t K = 1, class RRTree, class NTermsMap>
 auto simple_lookahead_factory(const RRTree& reverse_rules, const NTermsMap& nterms2defs)
 {
-    return SimpleLookahead(follow_set_factory(reverse_rules, nterms2defs));
+    auto follow = follow_set_factory(reverse_rules, nterms2defs);
+    if constexpr (K > 1)
+        follow.template link<typename NTermsMap::TDefsTuple>();
+    return SimpleLookahead<std::decay_t<decltype(follow)>, K>(follow);
 }
 
 #endif //FOLLOW_H
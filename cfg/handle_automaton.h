@@ -0,0 +1,199 @@
+#ifndef SUPERCFG_HANDLE_AUTOMATON_H
+#define SUPERCFG_HANDLE_AUTOMATON_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cfg/preprocess.h"
+#include "cfg/rule_program.h"
+
+
+/**
+ * @brief Position automaton over the reversed right-hand sides of all rules. The stack is read once from the top,
+ * each rule which may match a window [start, top] is reported with the window start. Repeats are compiled into loops, optional symbols into skipped positions.
+ * Matching is approximate: tokens are compared by their first character and Except is treated as its first operand, so reported rules should still be matched
+ */
+class HandleAutomaton
+{
+protected:
+    static constexpr std::uint32_t no_rule = static_cast<std::uint32_t>(-1);
+
+    /**
+     * @brief Leaf instruction of a rule
+     */
+    struct Position
+    {
+        RuleOpKind kind;
+        unsigned char lo, hi; // Characters range of the token
+        std::size_t nterm; // Nterm id
+        std::uint32_t rule; // Reported rule if the position may open it, no_rule otherwise
+        std::vector<std::uint32_t> pred; // Positions which may precede this one
+    };
+
+    /**
+     * @brief Positions of a subtree
+     */
+    struct Fragment
+    {
+        bool nullable = true;
+        std::vector<std::uint32_t> first, last;
+    };
+
+    std::vector<Position> positions;
+    std::vector<std::uint32_t> starts; // Positions which may close a rule
+    std::vector<std::size_t> opaque; // Rules with unsupported operators, reported for each window
+
+public:
+    /**
+     * @brief Scratch bitsets of the active positions, kept in the parse session
+     */
+    struct Scratch
+    {
+        std::vector<std::uint64_t> cur, next;
+    };
+
+    /**
+     * @brief Compile a rule into the automaton
+     * @param rule Reported rule id
+     * @param ops Rule program
+     */
+    void add_rule(std::size_t rule, const RuleOp* ops)
+    {
+        bool unsupported = false;
+        const Fragment frag = build(ops, 0, unsupported);
+        if (unsupported)
+        {
+            opaque.push_back(rule);
+            return;
+        }
+        for (const auto p : frag.first) positions[p].rule = static_cast<std::uint32_t>(rule);
+        starts.insert(starts.end(), frag.last.begin(), frag.last.end());
+    }
+
+    [[nodiscard]] std::size_t size() const { return positions.size(); }
+
+    const std::vector<std::size_t>& opaque_rules() const { return opaque; }
+
+    /**
+     * @brief Read the stack from the top down to lowest and report each (window start, rule) pair which may match
+     * @param report Callback (std::size_t start, std::size_t rule)
+     */
+    template<class VStr, class Type, class Report>
+    void scan(const SymbolStack<VStr, Type>& stack, std::size_t lowest, Scratch& scratch, Report&& report) const
+    {
+        const std::size_t n_words = (positions.size() + 63) / 64;
+        scratch.cur.assign(n_words, 0);
+        scratch.next.assign(n_words, 0);
+        for (const auto p : starts) scratch.cur[p >> 6] |= std::uint64_t(1) << (p & 63);
+
+        for (std::size_t j = stack.size(); j-- > lowest;)
+        {
+            const CompactSymbol& elem = stack.entry(j);
+            bool active = false;
+            for (std::size_t w = 0; w < n_words; w++)
+            {
+                for (std::uint64_t bits = scratch.cur[w]; bits != 0; bits &= bits - 1)
+                {
+                    const Position& pos = positions[(w << 6) + std::countr_zero(bits)];
+                    if (!accepts(pos, stack, elem)) continue;
+                    if (pos.rule != no_rule) report(j, pos.rule);
+                    for (const auto q : pos.pred)
+                        scratch.next[q >> 6] |= std::uint64_t(1) << (q & 63);
+                    active = active || !pos.pred.empty();
+                }
+            }
+            if (!active) break;
+            std::swap(scratch.cur, scratch.next);
+            std::fill(scratch.next.begin(), scratch.next.end(), 0);
+        }
+    }
+
+protected:
+    template<class VStr, class Type>
+    static bool accepts(const Position& pos, const SymbolStack<VStr, Type>& stack, const CompactSymbol& elem)
+    {
+        if (pos.kind == RuleOpKind::NTerm) return !elem.token && elem.index == pos.nterm;
+        if (!elem.token) return false;
+        const VStr& value = stack.resolve(elem).value;
+        if (value.empty()) return true;
+        const auto c = static_cast<unsigned char>(value[0]);
+        return c >= pos.lo && c <= pos.hi;
+    }
+
+    void connect(const std::vector<std::uint32_t>& from, const std::vector<std::uint32_t>& to)
+    {
+        // Reversed edges : the stack is read backwards
+        for (const auto b : to)
+            positions[b].pred.insert(positions[b].pred.end(), from.begin(), from.end());
+    }
+
+    Fragment build(const RuleOp* ops, std::size_t pc, bool& unsupported)
+    {
+        const RuleOp& op = ops[pc];
+        Fragment res;
+        switch (op.kind)
+        {
+            case RuleOpKind::Concat:
+                for (std::size_t child = pc + 1; child < op.next; child = ops[child].next)
+                {
+                    Fragment f = build(ops, child, unsupported);
+                    connect(res.last, f.first);
+                    if (res.nullable) res.first.insert(res.first.end(), f.first.begin(), f.first.end());
+                    if (f.nullable) res.last.insert(res.last.end(), f.last.begin(), f.last.end());
+                    else res.last = std::move(f.last);
+                    res.nullable = res.nullable && f.nullable;
+                }
+                return res;
+            case RuleOpKind::Alter:
+                res.nullable = false;
+                for (std::size_t child = pc + 1; child < op.next; child = ops[child].next)
+                {
+                    Fragment f = build(ops, child, unsupported);
+                    res.first.insert(res.first.end(), f.first.begin(), f.first.end());
+                    res.last.insert(res.last.end(), f.last.begin(), f.last.end());
+                    res.nullable = res.nullable || f.nullable;
+                }
+                return res;
+            case RuleOpKind::Optional:
+                res = build(ops, pc + 1, unsupported);
+                res.nullable = true;
+                return res;
+            case RuleOpKind::Repeat:
+            case RuleOpKind::RepeatN:
+                res = build(ops, pc + 1, unsupported);
+                if (op.kind == RuleOpKind::Repeat || op.to > 1) connect(res.last, res.first); // Loop
+                res.nullable = res.nullable || op.kind == RuleOpKind::Repeat || op.from == 0;
+                return res;
+            case RuleOpKind::Group:
+            case RuleOpKind::Except:
+                return build(ops, pc + 1, unsupported);
+            case RuleOpKind::Term:
+            case RuleOpKind::Range:
+            case RuleOpKind::NTerm:
+            {
+                Position pos{op.kind, 0, 255, op.from, no_rule, {}};
+                if (op.kind == RuleOpKind::Term && !op.name.empty())
+                    pos.lo = pos.hi = static_cast<unsigned char>(op.name[0]);
+                else if (op.kind == RuleOpKind::Range)
+                {
+                    pos.lo = static_cast<unsigned char>(op.start);
+                    pos.hi = static_cast<unsigned char>(op.end);
+                }
+                const auto p = static_cast<std::uint32_t>(positions.size());
+                positions.push_back(std::move(pos));
+                res.nullable = false;
+                res.first.push_back(p);
+                res.last.push_back(p);
+                return res;
+            }
+            default:
+                unsupported = true;
+                return res;
+        }
+    }
+};
+
+
+#endif //SUPERCFG_HANDLE_AUTOMATON_H
@@ -5,14 +5,44 @@
 #ifndef HASHTABLE_H
 #define HASHTABLE_H
 
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
 #include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <variant>
+#include <vector>
 
 #include "cfg/helpers.h"
+#include "cfg/symbol_id.h"
 #include "elemtree/element.h"
 
 
+namespace cfg_helpers
+{
+    /**
+     * @brief Character type of a string key. SymbolId names are plain chars
+     */
+    template<class Key>
+    struct key_char { using type = char; };
+
+    template<class Key> requires requires { typename Key::value_type; }
+    struct key_char<Key> { using type = typename Key::value_type; };
+}
+
+
+/**
+ * @brief Mapping between a type key and a symbol from the tuple. SymbolId keys are looked up in a dense array indexed by the id, other keys are hashed.
+ * Characters of terms ranges are stored once per range and found through a 256-entry table instead of a key per character.
+ * The symbol is dispatched through a compile-time table of function pointers, indexed by the variant alternative
+ * @tparam Key Type key
+ * @tparam ValuesTuple Tuple of all possible symbol types
+ */
 template<class Key, class ValuesTuple>
 class TypesHashTable
 {
@@ -22,35 +52,165 @@ public:
     // Morph values into std::variant type
     using ValuesVariant = variadic_morph_t<ValuesTuple>;
 
-    std::unordered_map<Key, ValuesVariant> storage;
+    static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max();
+    static constexpr bool is_dense = is_symbol_id_v<Key>;
+
+    using KeyChar = typename cfg_helpers::key_char<Key>::type;
+    using KeyView = std::basic_string_view<KeyChar>;
+    // Keys which are not viewed as strings are hashed as is, without the heterogeneous lookup and the characters table
+    static constexpr bool is_viewable = std::is_convertible_v<const Key&, KeyView>;
+
+    std::vector<Key> keys; // Keys in the insertion order
+
+protected:
+    /**
+     * @brief Transparent hash and comparator, so that string views are looked up without building an owning key
+     */
+    struct ViewHash
+    {
+        using is_transparent = void;
+        std::size_t operator()(const KeyView key) const noexcept { return std::hash<KeyView>{}(key); }
+    };
+
+    struct ViewEqual
+    {
+        using is_transparent = void;
+        bool operator()(const KeyView lhs, const KeyView rhs) const noexcept { return lhs == rhs; }
+    };
+
+    using KeyHash = std::conditional_t<is_viewable, ViewHash, std::hash<Key>>;
+    using KeyEqual = std::conditional_t<is_viewable, ViewEqual, std::equal_to<Key>>;
 
+    std::vector<ValuesVariant> values;
+    std::vector<std::uint32_t> dense; // SymbolId -> values position
+    std::unordered_map<Key, std::uint32_t, KeyHash, KeyEqual> sparse; // Key -> values position
+    std::array<std::uint32_t, 256> chars = empty_chars(); // Range character -> values position
+    std::array<bool, 256> single{}; // Single-character keys, which take precedence over the ranges inserted after them
+
+public:
     TypesHashTable(auto fill_storage, const std::size_t N)
     {
         for (std::size_t i = 0; i < N; i++)
         {
             // Initialize storage
-            fill_storage(i, storage);
+            fill_storage(i, *this);
         }
     }
 
     constexpr TypesHashTable() = default;
 
-    auto get(const Key& key, auto func) const
+    /**
+     * @brief Dispatch the value of the key. Any string class may be passed as the key, views are not copied
+     */
+    template<class K>
+    auto get(const K& key, auto func) const
     {
-        return std::visit([func](const auto& elem){ return func(elem); }, storage.at(key));
+        const std::uint32_t pos = find(key);
+        if (pos == npos) [[unlikely]]
+            throw std::out_of_range("TypesHashTable::get() : key not found");
+        return dispatch(values[pos], func);
     }
 
     template<class Val>
     void insert(const Key& key, const Val& value)
     {
         static_assert(tuple_contains_v<Val, ValuesTuple>, "Tuple does not contain such type");
+        if (contains(key)) return; // Same as std::unordered_map::insert
+
+        const auto pos = static_cast<std::uint32_t>(values.size());
+        Val v = value;
+        values.push_back(ValuesVariant(v));
+        keys.push_back(key);
+        if constexpr (is_dense)
+        {
+            if (dense.size() <= key.id) dense.resize(key.id + 1, npos);
+            dense[key.id] = pos;
+        } else sparse.insert({key, pos});
+
+        const int c = single_char(key);
+        if (c >= 0) single[c] = true;
+    }
+
+    /**
+     * @brief Insert a range of single-character keys [start, end] with one value. Characters which are already present are skipped
+     */
+    template<class Val>
+    void insert_range(const char start, const char end, const Val& value)
+    {
+        static_assert(tuple_contains_v<Val, ValuesTuple>, "Tuple does not contain such type");
+        const auto pos = static_cast<std::uint32_t>(values.size());
         Val v = value;
-        storage.insert({key, ValuesVariant(v)});
+        values.push_back(ValuesVariant(v));
+        for (std::size_t c = static_cast<unsigned char>(start); c <= static_cast<unsigned char>(end); c++)
+            if (chars[c] == npos && !single[c]) chars[c] = pos;
     }
 
     bool contains(const Key& key) const
     {
-        return storage.contains(key);
+        return find(key) != npos;
+    }
+
+    [[nodiscard]] std::size_t size() const { return values.size(); }
+
+protected:
+    template<class K>
+    std::uint32_t find(const K& key) const
+    {
+        const int c = single_char(key);
+        if (c >= 0 && chars[c] != npos) return chars[c];
+
+        if constexpr (is_dense)
+        {
+            std::size_t id;
+            if constexpr (std::is_same_v<std::decay_t<K>, Key>) id = key.id;
+            else id = Key(std::string_view(key)).id;
+            return id < dense.size() ? dense[id] : npos;
+        }
+        else
+        {
+            const auto it = [&]{
+                if constexpr (is_viewable) return sparse.find(KeyView(key)); // Heterogeneous lookup
+                else if constexpr (std::is_same_v<std::decay_t<K>, Key>) return sparse.find(key);
+                else return sparse.find(Key(key));
+            }();
+            return it != sparse.end() ? it->second : npos;
+        }
+    }
+
+    /**
+     * @brief Get the character of a single-character key, or -1
+     */
+    template<class K>
+    static int single_char(const K& key)
+    {
+        if constexpr (is_viewable)
+        {
+            const KeyView name = key;
+            if (name.size() != 1) return -1;
+            const auto c = static_cast<std::make_unsigned_t<KeyChar>>(name[0]);
+            return c < 256 ? static_cast<int>(c) : -1;
+        }
+        else return -1;
+    }
+
+    static constexpr std::array<std::uint32_t, 256> empty_chars()
+    {
+        std::array<std::uint32_t, 256> res{};
+        res.fill(npos);
+        return res;
+    }
+
+    template<class F>
+    static auto dispatch(const ValuesVariant& value, F& func)
+    {
+        using R = decltype(func(std::get<0>(value)));
+        // One entry per variant alternative
+        static constexpr auto table = []<std::size_t... I>(std::index_sequence<I...>){
+            return std::array<R(*)(const ValuesVariant&, F&), sizeof...(I)>{
+                [](const ValuesVariant& v, F& f) -> R { return f(*std::get_if<I>(&v)); }...
+            };
+        }(std::make_index_sequence<std::variant_size_v<ValuesVariant>>{});
+        return table[value.index()](value, func);
     }
 };
 
@@ -0,0 +1,1039 @@
+#ifndef SUPERCFG_LR_PARSER_H
+#define SUPERCFG_LR_PARSER_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "cfg/base.h"
+#include "cfg/containers.h"
+#include "cfg/preprocess.h"
+#include "cfg/rule_program.h"
+#include "cfg/symbol_id.h"
+
+
+enum class LRConfEnum : std::uint64_t
+{
+    GLR = 0x1, ///< Fall back to the GLR algorithm over a graph-structured stack if the LALR(1) tables have conflicts
+};
+
+
+template<std::uint64_t Conf>
+class LRParserConfig
+{
+public:
+    constexpr explicit LRParserConfig() {}
+
+    static constexpr std::uint64_t value() { return Conf; }
+
+    template<LRConfEnum value>
+    [[nodiscard]] static constexpr bool flag() { return (Conf & static_cast<std::uint64_t>(value)) > 0; }
+};
+
+template<LRConfEnum... Values>
+constexpr auto mk_lr_parser_conf()
+{
+    if constexpr(sizeof...(Values) == 0)
+        return LRParserConfig<0>();
+    else
+    {
+        constexpr std::uint64_t conf = (static_cast<const std::uint64_t>(Values) | ...);
+        return LRParserConfig<conf>();
+    }
+}
+
+
+struct LRProduction
+{
+    std::size_t lhs;
+    std::vector<std::size_t> rhs; // Encoded symbols, see LRGrammar::term_symbol and LRGrammar::nterm_symbol
+};
+
+
+struct LRTerminal
+{
+    bool range;
+    std::string_view name;
+    char start, end;
+};
+
+
+/**
+ * @brief Grammar in BNF form, lowered from the rule programs. Alter, Optional and repeats are replaced with auxiliary nterms, which are not present in the AST
+ */
+class LRGrammar
+{
+public:
+    static constexpr std::size_t eof = 0; // End of input terminal
+    static constexpr std::size_t never = 1; // Terminal which is never produced by the input, used for unsupported operators
+
+    std::vector<LRTerminal> terms;
+    std::vector<LRProduction> prods;
+    std::vector<std::vector<std::size_t>> nterm_prods; // Productions of each nterm
+    std::size_t n_defined; // Defined nterms go first, auxiliary nterms follow
+
+    explicit LRGrammar(std::size_t defined) : terms{LRTerminal{false, {}, 0, 0}, LRTerminal{false, {}, 0, 0}}, nterm_prods(defined), n_defined(defined) {}
+
+    static constexpr std::size_t term_symbol(std::size_t t) { return t * 2; }
+
+    static constexpr std::size_t nterm_symbol(std::size_t n) { return n * 2 + 1; }
+
+    static constexpr bool is_nterm(std::size_t s) { return s & 1; }
+
+    static constexpr std::size_t symbol_id(std::size_t s) { return s >> 1; }
+
+    [[nodiscard]] std::size_t n_nterms() const { return nterm_prods.size(); }
+
+    std::size_t add_nterm()
+    {
+        nterm_prods.emplace_back();
+        return nterm_prods.size() - 1;
+    }
+
+    std::size_t add_production(std::size_t lhs, std::vector<std::size_t> rhs)
+    {
+        nterm_prods[lhs].push_back(prods.size());
+        prods.push_back(LRProduction{lhs, std::move(rhs)});
+        return prods.size() - 1;
+    }
+
+    /**
+     * @brief Add the definition of a nterm
+     * @param ops Compiled rule of the definition
+     */
+    void add_definition(std::size_t nterm, const RuleOp* ops)
+    {
+        std::vector<std::size_t> seq;
+        lower_rule(ops, 0, seq);
+        add_production(nterm, std::move(seq));
+    }
+
+    /**
+     * @brief Remove the empty derivations. SRParser never reduces an empty window, so no nterm may be reduced to the empty string
+     */
+    void remove_empty()
+    {
+        std::vector<bool> nullable(n_nterms(), false);
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (const auto& p : prods)
+            {
+                if (nullable[p.lhs]) continue;
+                if (std::all_of(p.rhs.begin(), p.rhs.end(), [&](std::size_t s){ return is_nterm(s) && nullable[symbol_id(s)]; }))
+                    changed = nullable[p.lhs] = true;
+            }
+        }
+
+        std::vector<LRProduction> old = std::move(prods);
+        prods.clear();
+        for (auto& list : nterm_prods) list.clear();
+
+        for (const auto& p : old)
+        {
+            const std::size_t n = p.rhs.size();
+            auto is_nullable = [&](std::size_t i){ return is_nterm(p.rhs[i]) && nullable[symbol_id(p.rhs[i])]; };
+
+            std::size_t first = n, last = 0;
+            for (std::size_t i = 0; i < n; i++)
+            {
+                if (!is_nullable(i)) continue;
+                first = std::min(first, i);
+                last = i;
+            }
+            if (first == n)
+            {
+                add_nonempty(p.lhs, p.rhs);
+                continue;
+            }
+
+            // Nullable symbols are skipped through a chain of suffix nterms, one per position : S_i := X_i S_i+1 | S_i+1 | X_i.
+            // The first one is the lhs itself with the fixed prefix, the suffix after the last nullable symbol is kept as is
+            std::vector<bool> tail_null(n + 1, true); // X_i..X_n are all nullable
+            for (std::size_t i = n; i-- > 0;) tail_null[i] = tail_null[i + 1] && is_nullable(i);
+
+            std::vector<std::size_t> suffix(last + 1);
+            suffix[first] = p.lhs;
+            for (std::size_t i = first + 1; i <= last; i++) suffix[i] = add_nterm();
+
+            for (std::size_t i = first; i <= last; i++)
+            {
+                std::vector<std::size_t> head;
+                if (i == first) head.assign(p.rhs.begin(), p.rhs.begin() + first);
+                std::vector<std::size_t> rest;
+                if (i < last) rest.push_back(nterm_symbol(suffix[i + 1]));
+                else rest.assign(p.rhs.begin() + i + 1, p.rhs.end());
+
+                auto seq = [&](bool with_x, bool with_rest){
+                    std::vector<std::size_t> rhs(head);
+                    if (with_x) rhs.push_back(p.rhs[i]);
+                    if (with_rest) rhs.insert(rhs.end(), rest.begin(), rest.end());
+                    return rhs;
+                };
+                add_nonempty(suffix[i], seq(true, true));
+                if (!rest.empty() && tail_null[i + 1]) add_nonempty(suffix[i], seq(true, false));
+                if (is_nullable(i)) add_nonempty(suffix[i], seq(false, true));
+                if (!head.empty() && tail_null[i]) add_nonempty(suffix[i], seq(false, false));
+            }
+        }
+    }
+
+protected:
+    /**
+     * @brief Add a production which is not empty, not a unit self-derivation and is not present yet
+     */
+    void add_nonempty(std::size_t lhs, std::vector<std::size_t> rhs)
+    {
+        if (rhs.empty() || (rhs.size() == 1 && rhs[0] == nterm_symbol(lhs))) return;
+        if (std::any_of(nterm_prods[lhs].begin(), nterm_prods[lhs].end(), [&](std::size_t q){ return prods[q].rhs == rhs; })) return;
+        add_production(lhs, std::move(rhs));
+    }
+
+    std::size_t add_term(const RuleOp& op)
+    {
+        const bool range = op.kind == RuleOpKind::Range;
+        for (std::size_t t = never + 1; t < terms.size(); t++)
+        {
+            const LRTerminal& term = terms[t];
+            if (term.range == range && (range ? term.start == op.start && term.end == op.end : term.name == op.name))
+                return t;
+        }
+        terms.push_back(LRTerminal{range, op.name, op.start, op.end});
+        return terms.size() - 1;
+    }
+
+    /**
+     * @brief Append the symbols of the instruction subtree at pc to the sequence
+     */
+    void lower_rule(const RuleOp* ops, std::size_t pc, std::vector<std::size_t>& seq)
+    {
+        const RuleOp& op = ops[pc];
+        switch (op.kind)
+        {
+            case RuleOpKind::Concat:
+                for (std::size_t child = pc + 1; child < op.next; child = ops[child].next)
+                    lower_rule(ops, child, seq);
+                return;
+            case RuleOpKind::Group:
+            case RuleOpKind::Except: // Exceptions cannot be expressed in a context-free grammar, the first operand is matched
+                lower_rule(ops, pc + 1, seq);
+                return;
+            case RuleOpKind::Alter:
+            {
+                const std::size_t aux = add_nterm();
+                for (std::size_t child = pc + 1; child < op.next; child = ops[child].next)
+                {
+                    std::vector<std::size_t> alt;
+                    lower_rule(ops, child, alt);
+                    add_production(aux, std::move(alt));
+                }
+                seq.push_back(nterm_symbol(aux));
+                return;
+            }
+            case RuleOpKind::Optional:
+            {
+                // aux := <empty> | child
+                const std::size_t aux = add_nterm();
+                std::vector<std::size_t> child;
+                lower_rule(ops, pc + 1, child);
+                add_production(aux, {});
+                add_production(aux, std::move(child));
+                seq.push_back(nterm_symbol(aux));
+                return;
+            }
+            case RuleOpKind::Repeat:
+                seq.push_back(nterm_symbol(lower_repeat(ops, pc)));
+                return;
+            case RuleOpKind::RepeatN:
+            {
+                std::vector<std::size_t> child;
+                lower_rule(ops, pc + 1, child);
+                if (op.to == std::numeric_limits<std::size_t>::max())
+                {
+                    // child{from} child*
+                    for (std::size_t i = 0; i < op.from; i++) seq.insert(seq.end(), child.begin(), child.end());
+                    seq.push_back(nterm_symbol(lower_repeat(ops, pc)));
+                    return;
+                }
+                // aux := child{from} | ... | child{to}
+                const std::size_t aux = add_nterm();
+                for (std::size_t n = op.from; n <= op.to; n++)
+                {
+                    std::vector<std::size_t> alt;
+                    for (std::size_t i = 0; i < n; i++) alt.insert(alt.end(), child.begin(), child.end());
+                    add_production(aux, std::move(alt));
+                }
+                seq.push_back(nterm_symbol(aux));
+                return;
+            }
+            case RuleOpKind::Term:
+            case RuleOpKind::Range:
+                seq.push_back(term_symbol(add_term(op)));
+                return;
+            case RuleOpKind::NTerm:
+                seq.push_back(op.from < n_defined ? nterm_symbol(op.from) : term_symbol(never)); // Undefined nterms are never matched
+                return;
+            default:
+                seq.push_back(term_symbol(never));
+        }
+    }
+
+    /**
+     * @brief Left-recursive repetition of the operand at pc + 1 : aux := <empty> | aux child
+     */
+    std::size_t lower_repeat(const RuleOp* ops, std::size_t pc)
+    {
+        const std::size_t aux = add_nterm();
+        std::vector<std::size_t> rec{nterm_symbol(aux)};
+        lower_rule(ops, pc + 1, rec);
+        add_production(aux, {});
+        add_production(aux, std::move(rec));
+        return aux;
+    }
+};
+
+
+struct LRAction
+{
+    enum class Kind : std::uint8_t
+    {
+        Shift,
+        Reduce,
+        Accept
+    };
+
+    Kind kind;
+    std::uint32_t value; // Target state, production or the accepted nterm
+};
+
+
+/**
+ * @brief LALR(1) action and goto tables. Each defined nterm has its own start state, so that any nterm may be used as the root
+ * @tparam N Maximum number of terminals
+ */
+template<std::size_t N>
+class LRTables
+{
+public:
+    using Bits = TypeBitset<N>;
+    static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max();
+
+    LRGrammar grammar;
+    std::size_t n_states = 0, n_terms, n_nterms;
+    std::size_t n_conflicts = 0; // Number of table cells with more than one action
+    std::vector<std::uint32_t> start_states; // Start state of each defined nterm
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> cells; // [state * n_terms + terminal] -> range of the actions array
+    std::vector<LRAction> actions; // Shifts go first, reductions follow in the production order
+    std::vector<std::uint32_t> gotos; // [state * n_nterms + nterm] -> state
+
+    explicit LRTables(LRGrammar&& g) : grammar(std::move(g))
+    {
+        assert(grammar.terms.size() <= N && "LRTables() : guru meditation : grammar has more terminals than expected");
+
+        grammar.remove_empty();
+
+        // Augmented productions S' := S for each defined nterm
+        aug_begin = grammar.prods.size();
+        for (std::size_t d = 0; d < grammar.n_defined; d++)
+            grammar.add_production(grammar.add_nterm(), {LRGrammar::nterm_symbol(d)});
+
+        n_terms = grammar.terms.size();
+        n_nterms = grammar.n_nterms();
+
+        compute_first();
+        build_lr0();
+        build_lookaheads();
+        build_actions();
+    }
+
+    /**
+     * @brief Get the actions of the state on the terminal
+     */
+    [[nodiscard]] std::pair<const LRAction*, const LRAction*> action(std::size_t state, std::size_t term) const
+    {
+        const auto& cell = cells[state * n_terms + term];
+        return {actions.data() + cell.first, actions.data() + cell.first + cell.second};
+    }
+
+    [[nodiscard]] std::uint32_t go(std::size_t state, std::size_t nterm) const { return gotos[state * n_nterms + nterm]; }
+
+protected:
+    using Item = std::uint64_t; // Production in the high half, dot position in the low half
+
+    static constexpr Item make_item(std::size_t prod, std::size_t dot) { return (static_cast<Item>(prod) << 32) | dot; }
+
+    static constexpr std::size_t item_prod(Item it) { return it >> 32; }
+
+    static constexpr std::size_t item_dot(Item it) { return it & 0xffffffff; }
+
+    struct State
+    {
+        std::vector<Item> kernel;
+        std::vector<Bits> la; // Lookahead of each kernel item
+        std::map<std::size_t, std::uint32_t> next; // Transitions over the encoded symbols
+    };
+
+    std::size_t aug_begin;
+    std::vector<State> states;
+    std::vector<Bits> first;
+    std::vector<bool> nullable;
+
+    void compute_first()
+    {
+        first.assign(n_nterms, Bits());
+        nullable.assign(n_nterms, false);
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (const auto& p : grammar.prods)
+            {
+                Bits bits = first[p.lhs];
+                const bool null = first_of(p.rhs, 0, bits);
+                if (!(bits == first[p.lhs]) || (null && !nullable[p.lhs]))
+                {
+                    first[p.lhs] = bits;
+                    nullable[p.lhs] = nullable[p.lhs] || null;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Add FIRST of the sequence suffix to bits, returns true if the suffix is nullable
+     */
+    bool first_of(const std::vector<std::size_t>& seq, std::size_t from, Bits& bits) const
+    {
+        for (std::size_t i = from; i < seq.size(); i++)
+        {
+            const std::size_t id = LRGrammar::symbol_id(seq[i]);
+            if (!LRGrammar::is_nterm(seq[i]))
+            {
+                bits.set(id);
+                return false;
+            }
+            bits |= first[id];
+            if (!nullable[id]) return false;
+        }
+        return true;
+    }
+
+    std::vector<Item> closure0(const std::vector<Item>& kernel) const
+    {
+        std::vector<Item> items(kernel);
+        std::vector<bool> added(n_nterms, false);
+        for (std::size_t i = 0; i < items.size(); i++)
+        {
+            const auto& rhs = grammar.prods[item_prod(items[i])].rhs;
+            const std::size_t dot = item_dot(items[i]);
+            if (dot == rhs.size() || !LRGrammar::is_nterm(rhs[dot])) continue;
+
+            const std::size_t nterm = LRGrammar::symbol_id(rhs[dot]);
+            if (added[nterm]) continue;
+            added[nterm] = true;
+            for (const std::size_t p : grammar.nterm_prods[nterm])
+                items.push_back(make_item(p, 0));
+        }
+        return items;
+    }
+
+    void build_lr0()
+    {
+        std::map<std::vector<Item>, std::uint32_t> ids;
+        auto add_state = [&](std::vector<Item>&& kernel) -> std::uint32_t {
+            std::sort(kernel.begin(), kernel.end());
+            const auto it = ids.find(kernel);
+            if (it != ids.end()) return it->second;
+            const auto id = static_cast<std::uint32_t>(states.size());
+            ids.insert({kernel, id});
+            states.push_back(State{std::move(kernel), {}, {}});
+            return id;
+        };
+
+        for (std::size_t d = 0; d < grammar.n_defined; d++)
+            start_states.push_back(add_state({make_item(aug_begin + d, 0)}));
+
+        for (std::size_t s = 0; s < states.size(); s++)
+        {
+            std::map<std::size_t, std::vector<Item>> kernels;
+            for (const Item it : closure0(states[s].kernel))
+            {
+                const auto& rhs = grammar.prods[item_prod(it)].rhs;
+                if (item_dot(it) < rhs.size())
+                    kernels[rhs[item_dot(it)]].push_back(it + 1);
+            }
+            for (auto& [symbol, kernel] : kernels)
+            {
+                const std::uint32_t target = add_state(std::move(kernel));
+                states[s].next.insert({symbol, target});
+            }
+        }
+        n_states = states.size();
+    }
+
+    /**
+     * @brief LR(1) closure of the state kernel with the current lookaheads
+     */
+    std::map<Item, Bits> closure1(const State& state) const
+    {
+        std::map<Item, Bits> items;
+        std::vector<Item> work;
+        for (std::size_t i = 0; i < state.kernel.size(); i++)
+        {
+            items[state.kernel[i]] |= state.la[i];
+            work.push_back(state.kernel[i]);
+        }
+
+        while (!work.empty())
+        {
+            const Item it = work.back();
+            work.pop_back();
+            const auto& rhs = grammar.prods[item_prod(it)].rhs;
+            const std::size_t dot = item_dot(it);
+            if (dot == rhs.size() || !LRGrammar::is_nterm(rhs[dot])) continue;
+
+            Bits la;
+            if (first_of(rhs, dot + 1, la)) la |= items[it];
+            for (const std::size_t p : grammar.nterm_prods[LRGrammar::symbol_id(rhs[dot])])
+            {
+                const auto [target, inserted] = items.try_emplace(make_item(p, 0));
+                Bits merged = target->second;
+                merged |= la;
+                if (!inserted && merged == target->second) continue;
+                target->second = merged;
+                work.push_back(make_item(p, 0));
+            }
+        }
+        return items;
+    }
+
+    /**
+     * @brief Propagate the lookaheads over the LR(0) automaton until the fixpoint is reached
+     */
+    void build_lookaheads()
+    {
+        for (auto& state : states) state.la.assign(state.kernel.size(), Bits());
+        for (const std::uint32_t s : start_states) states[s].la[0].set(LRGrammar::eof);
+
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (std::size_t s = 0; s < n_states; s++)
+            {
+                for (const auto& [it, la] : closure1(states[s]))
+                {
+                    const auto& rhs = grammar.prods[item_prod(it)].rhs;
+                    if (item_dot(it) == rhs.size()) continue;
+
+                    State& target = states[states[s].next.at(rhs[item_dot(it)])];
+                    const auto pos = std::lower_bound(target.kernel.begin(), target.kernel.end(), it + 1) - target.kernel.begin();
+                    Bits merged = target.la[pos];
+                    merged |= la;
+                    if (!(merged == target.la[pos]))
+                    {
+                        target.la[pos] = merged;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    void build_actions()
+    {
+        cells.assign(n_states * n_terms, {0, 0});
+        gotos.assign(n_states * n_nterms, npos);
+
+        for (std::size_t s = 0; s < n_states; s++)
+        {
+            std::vector<std::vector<LRAction>> row(n_terms);
+            for (const auto& [symbol, target] : states[s].next)
+            {
+                if (LRGrammar::is_nterm(symbol))
+                    gotos[s * n_nterms + LRGrammar::symbol_id(symbol)] = target;
+                else
+                    row[LRGrammar::symbol_id(symbol)].push_back(LRAction{LRAction::Kind::Shift, target});
+            }
+
+            for (const auto& [it, la] : closure1(states[s]))
+            {
+                const std::size_t p = item_prod(it);
+                if (item_dot(it) != grammar.prods[p].rhs.size()) continue;
+                for (std::size_t t = 0; t < n_terms; t++)
+                {
+                    if (!la.test(t)) continue;
+                    if (p >= aug_begin)
+                    {
+                        if (t == LRGrammar::eof) row[t].push_back(LRAction{LRAction::Kind::Accept, static_cast<std::uint32_t>(p - aug_begin)});
+                    } else
+                        row[t].push_back(LRAction{LRAction::Kind::Reduce, static_cast<std::uint32_t>(p)});
+                }
+            }
+
+            for (std::size_t t = 0; t < n_terms; t++)
+            {
+                cells[s * n_terms + t] = {static_cast<std::uint32_t>(actions.size()), static_cast<std::uint32_t>(row[t].size())};
+                actions.insert(actions.end(), row[t].begin(), row[t].end());
+                if (row[t].size() > 1) n_conflicts++;
+            }
+        }
+    }
+};
+
+
+namespace cfg_helpers
+{
+    template<class Tree>
+    struct lr_node_value { using type = std::remove_cvref_t<decltype(std::declval<Tree&>().value)>; };
+
+    template<class VStr, class TIndex>
+    struct lr_node_value<FlatTree<VStr, TIndex>> { using type = VStr; };
+}
+
+
+/**
+ * @brief Table-driven parser which is built from the same grammar as SRParser. Uses the LALR(1) tables if they have no conflicts, otherwise GLR may be enabled.
+ * Tokens are matched against the grammar terminals by their values, the AST has the same layout as the SRParser one
+ * @tparam VStr Variable string class
+ * @tparam TokenType Nonterminal type (name) container
+ * @tparam TokenTSet Token types container of the lexer
+ * @tparam Tree Parser tree node class
+ * @tparam RulesSymbol Rules class
+ */
+template<class VStr, class TokenType, class TokenTSet, class Tree, class RulesSymbol, std::uint64_t Conf>
+class LRParser
+{
+public:
+    static constexpr std::size_t n_bits = cfg_helpers::symbol_names_count<RulesSymbol>() + 2;
+    using TokenV = Token<VStr, TokenTSet>;
+    using NodeValue = typename cfg_helpers::lr_node_value<Tree>::type;
+
+    LRTables<n_bits> tables;
+    LRParserConfig<Conf> conf;
+    std::vector<TokenType> names; // Name of each defined nterm
+    std::unordered_map<std::string_view, std::size_t> term_ids;
+    std::array<std::vector<std::size_t>, 256> range_terms; // Range terminals which contain each character
+
+    constexpr explicit LRParser(const RulesSymbol& rules, LRParserConfig<Conf> conf) : tables(lower_grammar()), conf(conf)
+    {
+        names.resize(tables.grammar.n_defined);
+        [&]<class... Defs>(const std::tuple<Defs...>*){
+            ((names[cfg_helpers::defined_nterm_id<get_first_t<Defs>, RulesSymbol>()] = TokenType(get_first_t<Defs>().type())), ...);
+        }(static_cast<const typename RulesSymbol::term_types_tuple*>(nullptr));
+
+        for (std::size_t t = LRGrammar::never + 1; t < tables.grammar.terms.size(); t++)
+        {
+            const LRTerminal& term = tables.grammar.terms[t];
+            if (!term.range)
+            {
+                term_ids.insert({term.name, t});
+                continue;
+            }
+            for (std::size_t c = 0; c < range_terms.size(); c++)
+                if (in_lexical_range<char>(static_cast<char>(c), term.start, term.end)) range_terms[c].push_back(t);
+        }
+    }
+
+    /**
+     * @brief Part of the node which is not reduced yet : concatenated token values and the number of created child nodes
+     */
+    struct Fragment
+    {
+        NodeValue value;
+        std::size_t n_nodes = 0;
+    };
+
+    /**
+     * @brief Mutable state of a parser run. The tables are only read during parsing, so one parser may serve several threads, each with its own session
+     */
+    struct ParseSession
+    {
+        std::vector<std::size_t> token_terms; // Terminals of each token
+        std::vector<std::size_t> token_terms_pos; // Position of the token terminals
+        std::vector<std::uint32_t> states; // LALR stack
+        std::vector<Fragment> fragments; // ditto
+    };
+
+    /**
+     * @brief Check if the LALR(1) tables are deterministic
+     */
+    [[nodiscard]] bool has_conflicts() const { return tables.n_conflicts > 0; }
+
+    /**
+     * @brief Create a new parse session, its buffers are reused between the runs
+     */
+    [[nodiscard]] ParseSession make_session() const { return ParseSession(); }
+
+    /**
+     * @brief Run with a new session, which is dropped afterwards
+     */
+    template<class RootSymbol>
+    bool run(Tree& node, const RootSymbol& root, std::vector<TokenV>& tokens) const
+    {
+        ParseSession s = make_session();
+        return run(node, root, tokens, s);
+    }
+
+    /**
+     * @brief Reentrant run, all mutable state is stored in the session
+     */
+    template<class RootSymbol>
+    bool run(Tree& node, const RootSymbol& root, std::vector<TokenV>& tokens, ParseSession& s) const
+    {
+        constexpr std::size_t root_id = cfg_helpers::defined_nterm_id<std::remove_cvref_t<RootSymbol>, RulesSymbol>();
+        static_assert(root_id != std::numeric_limits<std::size_t>::max(), "Root symbol is not defined in the grammar");
+
+        // Map the tokens onto the terminals, the last one is the end of input
+        auto& token_terms = s.token_terms;
+        auto& token_terms_pos = s.token_terms_pos;
+        token_terms.clear();
+        token_terms_pos.assign(1, 0);
+        for (const auto& tok : tokens)
+        {
+            const std::string_view value(tok.value.data(), tok.value.size());
+            if (const auto it = term_ids.find(value); it != term_ids.end())
+                token_terms.push_back(it->second);
+            if (value.size() == 1)
+            {
+                const auto& ranges = range_terms[static_cast<unsigned char>(value[0])];
+                token_terms.insert(token_terms.end(), ranges.begin(), ranges.end());
+            }
+            if (token_terms.size() == token_terms_pos.back()) return false; // Token is not present in the grammar
+            token_terms_pos.push_back(token_terms.size());
+        }
+        token_terms.push_back(LRGrammar::eof);
+        token_terms_pos.push_back(token_terms.size());
+
+        if constexpr (conf.template flag<LRConfEnum::GLR>())
+        {
+            if (has_conflicts()) return run_glr(node, root_id, tokens, s);
+        }
+        return run_lalr(node, root_id, tokens, s);
+    }
+
+protected:
+    static LRGrammar lower_grammar()
+    {
+        constexpr std::size_t n_defined = []<class... Defs>(const std::tuple<Defs...>*){
+            return std::max({std::size_t(0), (cfg_helpers::defined_nterm_id<get_first_t<Defs>, RulesSymbol>() + 1)...});
+        }(static_cast<const typename RulesSymbol::term_types_tuple*>(nullptr));
+
+        LRGrammar grammar(n_defined);
+        [&]<class... Defs>(const std::tuple<Defs...>*){
+            (grammar.add_definition(cfg_helpers::defined_nterm_id<get_first_t<Defs>, RulesSymbol>(), RuleProgram<std::decay_t<get_second_t<Defs>>, RulesSymbol>::ops.data()), ...);
+        }(static_cast<const typename RulesSymbol::term_types_tuple*>(nullptr));
+        return grammar;
+    }
+
+    /**
+     * @brief Create a node of the defined nterm from the fragment, child nodes are the last root children
+     */
+    void make_node(Tree* root, std::size_t nterm, Fragment& frag) const
+    {
+        if constexpr (is_flat_tree_v<Tree>)
+            root->reduce(names[nterm], frag.n_nodes, std::move(frag.value));
+        else
+        {
+            Tree new_node(names[nterm], root);
+            new_node.add_value(frag.value);
+            for (std::size_t j = 0; j < frag.n_nodes; j++)
+            {
+                // Same children order as in the SRParser reduce
+                Tree& elem = root->nodes.back();
+                elem.parent = &new_node;
+                new_node.add(elem);
+                root->nodes.erase(root->nodes.end() - 1);
+            }
+            root->add(new_node);
+        }
+    }
+
+    /**
+     * @brief Deterministic LALR(1) loop. Conflicts are resolved in favor of shift, then the first production
+     */
+    bool run_lalr(Tree& node, std::size_t root_id, const std::vector<TokenV>& tokens, ParseSession& s) const
+    {
+        const auto& token_terms = s.token_terms;
+        const auto& token_terms_pos = s.token_terms_pos;
+        auto& states = s.states;
+        auto& fragments = s.fragments;
+        states.assign(1, tables.start_states[root_id]);
+        fragments.assign(1, Fragment());
+
+        std::size_t i = 0;
+        while (true)
+        {
+            // Pick the first terminal of the token which has an action
+            const LRAction* act = nullptr;
+            for (std::size_t l = token_terms_pos[i]; l < token_terms_pos[i + 1] && act == nullptr; l++)
+            {
+                const auto [begin, end] = tables.action(states.back(), token_terms[l]);
+                if (begin != end) act = begin;
+            }
+            if (act == nullptr) return false;
+
+            switch (act->kind)
+            {
+                case LRAction::Kind::Shift:
+                    states.push_back(act->value);
+                    fragments.push_back(Fragment{NodeValue(tokens[i].value), 0});
+                    i++;
+                    break;
+                case LRAction::Kind::Reduce:
+                {
+                    const LRProduction& p = tables.grammar.prods[act->value];
+                    Fragment frag;
+                    for (std::size_t j = fragments.size() - p.rhs.size(); j < fragments.size(); j++)
+                    {
+                        frag.value += fragments[j].value;
+                        frag.n_nodes += fragments[j].n_nodes;
+                    }
+                    states.resize(states.size() - p.rhs.size());
+                    fragments.resize(fragments.size() - p.rhs.size());
+
+                    if (p.lhs < tables.grammar.n_defined)
+                    {
+                        make_node(&node, p.lhs, frag);
+                        frag = Fragment{NodeValue(), 1};
+                    }
+                    states.push_back(tables.go(states.back(), p.lhs));
+                    fragments.push_back(std::move(frag));
+                    break;
+                }
+                case LRAction::Kind::Accept:
+                    return true;
+            }
+        }
+    }
+
+    /**
+     * @brief Node of the graph-structured stack
+     */
+    struct GSSNode
+    {
+        std::uint32_t state;
+        std::vector<std::pair<std::size_t, std::size_t>> edges; // Previous node and the semantic value of the symbol
+    };
+
+    /**
+     * @brief Symbol derivation. Only one derivation of each symbol over the same tokens is kept, see prefer()
+     */
+    struct SemNode
+    {
+        std::size_t nterm; // npos for tokens
+        std::size_t begin, end; // Derived tokens range
+        std::vector<std::size_t> children;
+    };
+
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    /**
+     * @brief GLR loop over the graph-structured stack, which performs all actions of the conflicting cells.
+     * There are no empty productions, so each edge leads to a previous position and the new reduction paths start with the new edge
+     */
+    bool run_glr(Tree& node, std::size_t root_id, const std::vector<TokenV>& tokens, const ParseSession& session) const
+    {
+        const auto& token_terms = session.token_terms;
+        const auto& token_terms_pos = session.token_terms_pos;
+        std::vector<GSSNode> gss{GSSNode{tables.start_states[root_id], {}}};
+        std::vector<SemNode> sem;
+        std::vector<std::size_t> level{0}; // Stack tops of the current position
+        std::vector<std::size_t> level_of(tables.n_states, npos); // Stack top of each state
+
+        for (std::size_t i = 0; i <= tokens.size(); i++)
+        {
+            for (const std::size_t v : level) level_of[gss[v].state] = v;
+
+            // Reduce until no new stack tops or edges appear. Each path is enumerated once, from its first edge
+            std::vector<std::pair<std::size_t, std::size_t>> work; // Stack top and its edge
+            for (const std::size_t v : level)
+                for (std::size_t e = 0; e < gss[v].edges.size(); e++) work.emplace_back(v, e);
+            while (!work.empty())
+            {
+                const auto [v, edge] = work.back();
+                work.pop_back();
+                for (std::size_t l = token_terms_pos[i]; l < token_terms_pos[i + 1]; l++)
+                {
+                    const auto [begin, end] = tables.action(gss[v].state, token_terms[l]);
+                    for (const LRAction* act = begin; act != end; act++)
+                    {
+                        if (act->kind != LRAction::Kind::Reduce) continue;
+
+                        const LRProduction& p = tables.grammar.prods[act->value];
+                        std::vector<std::size_t> path{gss[v].edges[edge].second};
+                        glr_paths(gss, gss[v].edges[edge].first, p.rhs.size() - 1, path, [&](std::size_t u, const std::vector<std::size_t>& values){
+                            const std::uint32_t s = tables.go(gss[u].state, p.lhs);
+                            if (s == LRTables<n_bits>::npos) return;
+
+                            std::vector<std::size_t> children(values.rbegin(), values.rend());
+                            std::size_t w = level_of[s];
+                            if (w != npos)
+                            {
+                                for (const auto& e : gss[w].edges)
+                                {
+                                    if (e.first != u) continue;
+                                    // Local ambiguity, the derivations above share the node
+                                    if (prefer(sem, children, sem[e.second].children) && !derives(sem, children.front(), e.second)) sem[e.second].children = std::move(children);
+                                    return;
+                                }
+                            }
+                            sem.push_back(SemNode{p.lhs, sem[children.front()].begin, sem[children.back()].end, std::move(children)});
+                            if (w == npos)
+                            {
+                                w = gss.size();
+                                gss.push_back(GSSNode{s, {}});
+                                level.push_back(w);
+                                level_of[s] = w;
+                            }
+                            gss[w].edges.emplace_back(u, sem.size() - 1);
+                            work.emplace_back(w, gss[w].edges.size() - 1); // New edge may create new reduction paths
+                        });
+                    }
+                }
+            }
+
+            if (i == tokens.size())
+            {
+                // Accepted node is reached from the start node with the root symbol, after all derivations are packed
+                for (const std::size_t v : level)
+                {
+                    const auto [begin, end] = tables.action(gss[v].state, LRGrammar::eof);
+                    if (std::none_of(begin, end, [](const LRAction& act){ return act.kind == LRAction::Kind::Accept; })) continue;
+                    for (const auto& [prev, value] : gss[v].edges)
+                    {
+                        if (prev != 0) continue;
+                        emit(node, sem, tokens, value);
+                        return true;
+                    }
+                }
+                break;
+            }
+
+            // Shift the token
+            std::vector<std::size_t> next;
+            sem.push_back(SemNode{npos, i, i + 1, {}});
+            for (const std::size_t v : level)
+            {
+                for (std::size_t l = token_terms_pos[i]; l < token_terms_pos[i + 1]; l++)
+                {
+                    const auto [begin, end] = tables.action(gss[v].state, token_terms[l]);
+                    for (const LRAction* act = begin; act != end; act++)
+                    {
+                        if (act->kind != LRAction::Kind::Shift) continue;
+                        std::size_t w = npos;
+                        for (const std::size_t n : next)
+                            if (gss[n].state == act->value) w = n;
+                        if (w == npos)
+                        {
+                            w = gss.size();
+                            gss.push_back(GSSNode{act->value, {}});
+                            next.push_back(w);
+                        }
+                        gss[w].edges.emplace_back(v, sem.size() - 1);
+                    }
+                }
+            }
+
+            for (const std::size_t v : level) level_of[gss[v].state] = npos;
+            if (next.empty()) return false;
+            level = std::move(next);
+        }
+        return false;
+    }
+
+    /**
+     * @brief Check if the derivation is preferred over the other one of the same symbol and tokens. The leftmost-longest children are preferred, as with the shift-first LALR(1) resolution
+     */
+    static bool prefer(const std::vector<SemNode>& sem, const std::vector<std::size_t>& lhs, const std::vector<std::size_t>& rhs)
+    {
+        for (std::size_t j = 0; j < lhs.size() && j < rhs.size(); j++)
+        {
+            const std::size_t l = sem[lhs[j]].end - sem[lhs[j]].begin, r = sem[rhs[j]].end - sem[rhs[j]].begin;
+            if (l != r) return l > r;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Check if the derivation contains the node, only the unit derivations over the same tokens are visited
+     */
+    static bool derives(const std::vector<SemNode>& sem, std::size_t i, std::size_t target)
+    {
+        if (i == target) return true;
+        for (const std::size_t child : sem[i].children)
+            if (sem[child].begin == sem[target].begin && sem[child].end == sem[target].end && derives(sem, child, target)) return true;
+        return false;
+    }
+
+    /**
+     * @brief Enumerate all paths of the given length from the GSS node, values are collected from the top
+     */
+    template<class Callback>
+    void glr_paths(const std::vector<GSSNode>& gss, std::size_t v, std::size_t len, std::vector<std::size_t>& values, Callback&& callback) const
+    {
+        if (len == 0)
+        {
+            callback(v, values);
+            return;
+        }
+        // Edges are only added to the stack tops, which are not reached from the other ones
+        for (std::size_t e = 0; e < gss[v].edges.size(); e++)
+        {
+            const auto [prev, value] = gss[v].edges[e];
+            values.push_back(value);
+            glr_paths(gss, prev, len - 1, values, callback);
+            values.pop_back();
+        }
+    }
+
+    /**
+     * @brief Build the AST of the derivation
+     */
+    void emit(Tree& node, const std::vector<SemNode>& sem, const std::vector<TokenV>& tokens, std::size_t root) const
+    {
+        Fragment frag;
+        emit_fragment(node, sem, tokens, root, frag);
+    }
+
+    void emit_fragment(Tree& node, const std::vector<SemNode>& sem, const std::vector<TokenV>& tokens, std::size_t i, Fragment& frag) const
+    {
+        const SemNode& s = sem[i];
+        if (s.nterm == npos)
+        {
+            frag.value += tokens[s.begin].value;
+            return;
+        }
+        if (s.nterm >= tables.grammar.n_defined)
+        {
+            // Auxiliary nterms are merged into the parent
+            for (const std::size_t child : s.children) emit_fragment(node, sem, tokens, child, frag);
+            return;
+        }
+        Fragment inner;
+        for (const std::size_t child : s.children) emit_fragment(node, sem, tokens, child, inner);
+        make_node(&node, s.nterm, inner);
+        frag.n_nodes++;
+    }
+};
+
+
+template<class VStr, class TokenType, class Tree, class RulesSymbol, class TLexer, class Conf>
+auto make_lr_parser(const RulesSymbol& rules, const TLexer& lex, Conf conf)
+{
+    if constexpr (is_symbol_id_v<TokenType>)
+        static_assert(std::is_same_v<typename TokenType::rules_type, std::remove_cvref_t<RulesSymbol>>, "SymbolId was built for a different grammar");
+
+    using TokenSetClass = typename TLexer::TokenSetClass;
+    return LRParser<VStr, TokenType, TokenSetClass, Tree, std::decay_t<RulesSymbol>, decltype(conf)::value()>(rules, conf);
+}
+
+
+#endif //SUPERCFG_LR_PARSER_H
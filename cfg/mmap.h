@@ -0,0 +1,157 @@
+#ifndef SUPERCFG_MMAP_H
+#define SUPERCFG_MMAP_H
+
+#include <cerrno>
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SUPERCFG_HAS_MMAP
+#else
+#include <fstream>
+#endif
+
+
+/**
+ * @brief Read-only input text over a memory-mapped file. Pages are loaded on access and shared through the page cache, the mapping is advised for sequential reading.
+ * May be passed to any lexer in place of a string. With StrView token values, the tokens reference the mapping, which must outlive them
+ * @tparam TChar Character type
+ */
+template<class TChar>
+class MappedFile
+{
+protected:
+    const TChar* _data = nullptr;
+    std::size_t _size = 0; // Number of characters
+    std::size_t _bytes = 0; // Mapping length
+#ifndef SUPERCFG_HAS_MMAP
+    std::vector<TChar> buffer; // Fallback storage if mmap is not available
+#endif
+
+public:
+    using value_type = TChar;
+
+    MappedFile() = default;
+
+    /**
+     * @brief Map the whole file
+     * @param path File path
+     * @param ok Set to false if the file cannot be opened or mapped
+     */
+    MappedFile(const char* path, bool& ok)
+    {
+#ifdef SUPERCFG_HAS_MMAP
+        ok = false;
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return;
+
+        struct stat st{};
+        if (::fstat(fd, &st) == 0)
+        {
+            ok = true;
+            _bytes = static_cast<std::size_t>(st.st_size);
+            if (_bytes > 0)
+            {
+                void* addr = ::mmap(nullptr, _bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr == MAP_FAILED)
+                {
+                    ok = false;
+                    _bytes = 0;
+                } else {
+                    ::madvise(addr, _bytes, MADV_SEQUENTIAL);
+                    _data = static_cast<const TChar*>(addr);
+                    _size = _bytes / sizeof(TChar);
+                }
+            }
+        }
+        ::close(fd); // The mapping stays valid
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        ok = file.is_open();
+        if (!ok) return;
+        const auto n = static_cast<std::size_t>(file.tellg());
+        buffer.resize(n / sizeof(TChar));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(TChar)));
+        _data = buffer.data();
+        _size = buffer.size();
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& rhs) noexcept { swap(rhs); }
+
+    MappedFile& operator=(MappedFile&& rhs) noexcept
+    {
+        MappedFile tmp(std::move(rhs));
+        swap(tmp);
+        return *this;
+    }
+
+    ~MappedFile()
+    {
+#ifdef SUPERCFG_HAS_MMAP
+        if (_data != nullptr) ::munmap(const_cast<TChar*>(_data), _bytes);
+#endif
+    }
+
+    [[nodiscard]] std::size_t size() const { return _size; }
+
+    [[nodiscard]] bool empty() const { return _size == 0; }
+
+    [[nodiscard]] const TChar* data() const { return _data; }
+
+    const TChar& operator[](std::size_t i) const { return _data[i]; }
+
+    [[nodiscard]] std::basic_string_view<TChar> view() const { return std::basic_string_view<TChar>(_data, _size); }
+
+    // Token values are sliced through the view
+    operator std::basic_string_view<TChar>() const { return view(); }
+
+protected:
+    void swap(MappedFile& rhs) noexcept
+    {
+        std::swap(_data, rhs._data);
+        std::swap(_size, rhs._size);
+        std::swap(_bytes, rhs._bytes);
+#ifndef SUPERCFG_HAS_MMAP
+        std::swap(buffer, rhs.buffer);
+#endif
+    }
+};
+
+
+#ifdef SUPERCFG_HAS_MMAP
+/**
+ * @brief Create the reader over a file descriptor (pipe, socket) for the streaming lexer. Read errors and an input which ends inside a character are reported as errors
+ */
+template<class TChar>
+auto make_fd_reader(int fd)
+{
+    return [fd](TChar* dst, std::size_t n) -> std::ptrdiff_t {
+        char* bytes = reinterpret_cast<char*>(dst);
+        std::size_t got = 0;
+        // A short read may end inside a character, the rest of it is read before returning
+        while (true)
+        {
+            const ssize_t res = ::read(fd, bytes + got, n * sizeof(TChar) - got);
+            if (res < 0 && errno == EINTR) continue;
+            if (res < 0) return -1;
+            if (res == 0) return got == 0 ? 0 : -1;
+            got += static_cast<std::size_t>(res);
+            if (got % sizeof(TChar) == 0) return static_cast<std::ptrdiff_t>(got / sizeof(TChar));
+        }
+    };
+}
+#endif
+
+
+#endif //SUPERCFG_MMAP_H
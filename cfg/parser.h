@@ -5,10 +5,17 @@
 #ifndef SUPERCFG_PARSER_H
 #define SUPERCFG_PARSER_H
 
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
 #include "follow.h"
 #include "cfg/preprocess.h"
 #include "cfg/preprocess_factories.h"
 #include "cfg/context.h"
+#include "cfg/rule_program.h"
+#include "cfg/handle_automaton.h"
 
 
 /**
@@ -341,6 +348,10 @@ enum class SRConfEnum : std::uint64_t
     ReducibilityChecker = 0x100, ///< Enable ReducibilityChecker(1) module which checks if a rule can be reduced 1 step in the future
     RC1CheckContext = 0x1000, ///< Enable RC(1) partial context analysis feature. Inferior to a full context manager
     HeuristicCtx = 0x10000,   ///< Enable (pre/post)fix based context analyzer (aka ContextManager)
+    LazyAutomaton = 0x100000, ///< Memoize the reduce decisions of the visited parser states. Only used without PrettyPrint, RC(1) and HeuristicCtx, which depend on the parsing history
+    HandleAutomaton = 0x1000000, ///< Find the rules which may match each window in one pass over the stack, using an automaton over the reversed rules. Only used without PrettyPrint
+    Lookahead2 = 0x10000000, ///< Check two tokens ahead (LA(2)) : a reduction is only prevented if the second token may follow the first one. Requires Lookahead
+    ShiftOnly = 0x100000000, ///< Shift right away if no rule may end with the top symbol, or if the lookahead prevents each rule which may. Only used without PrettyPrint
 };
 
 
@@ -369,6 +380,243 @@ constexpr auto mk_sr_parser_conf()
 }
 
 
+namespace cfg_helpers
+{
+    /**
+     * @brief Upper bound of the number of distinct token types in the grammar, which is the width of the type bitsets
+     */
+    template<class TokenType, class SymbolsHT>
+    constexpr std::size_t type_bits_count()
+    {
+        if constexpr (is_symbol_id_v<TokenType>)
+            return TokenType::size();
+        else
+        {
+            constexpr auto count = []<class... Ts>(const std::tuple<Ts...>*){ return (std::size_t(0) + ... + symbol_names_count<Ts>()); };
+            return count(static_cast<const std::remove_cvref_t<typename SymbolsHT::TermsTuple>*>(nullptr)) +
+                   count(static_cast<const std::remove_cvref_t<typename SymbolsHT::NTermsTuple>*>(nullptr));
+        }
+    }
+}
+
+
+/**
+ * @brief Incremental storage of the common types of each stack window [i, top]. Shift appends a single column, reduce drops the columns above the handle.
+ * Windows of a column only shrink to the left, so the equal adjacent windows are stored once : a column of nested symbols with one common type takes a single entry
+ * @tparam TWindow Common types of a window, should provide empty() and operator==
+ */
+template<class TWindow>
+class IntersectCache
+{
+protected:
+    struct Segment
+    {
+        std::size_t start; ///< Windows [i, p] with i from start to the next segment start are equal
+        TWindow window;
+    };
+
+    std::vector<std::vector<Segment>> columns; ///< Segments of each column p, the first one starts at the longest non-empty window. Longer windows cannot become non-empty
+    std::size_t n_stored = 0; ///< Number of segments in all columns
+    std::size_t n_peak = 0; ///< ditto, the maximum since reset()
+
+public:
+    IntersectCache() = default;
+
+    void reset()
+    {
+        columns.clear();
+        n_stored = n_peak = 0;
+    }
+
+    /**
+     * @brief Number of stack symbols covered by the cache
+     */
+    [[nodiscard]] std::size_t size() const { return columns.size(); }
+
+    /**
+     * @brief Maximum number of stored windows since the last reset()
+     */
+    [[nodiscard]] std::size_t peak() const { return n_peak; }
+
+    /**
+     * @brief Start of the longest window of the top column which has common types
+     */
+    [[nodiscard]] std::size_t first() const { return columns.back().front().start; }
+
+    /**
+     * @brief Get the intersection of the window [i, top]. Requires i >= first()
+     */
+    [[nodiscard]] const TWindow& get(std::size_t i) const
+    {
+        const auto& col = columns.back();
+        const auto it = std::upper_bound(col.begin(), col.end(), i, [](std::size_t pos, const Segment& seg){ return pos < seg.start; });
+        return std::prev(it)->window;
+    }
+
+    /**
+     * @brief Append a new stack symbol
+     * @param init Callback which initializes the window starting with the new symbol
+     * @param step Callback which crops the previous window with the new symbol
+     */
+    template<class Init, class Step>
+    void push(Init&& init, Step&& step)
+    {
+        const std::size_t p = columns.size();
+        std::vector<Segment> col;
+        if (p > 0)
+        {
+            const auto& prev = columns.back();
+            col.reserve(prev.size() + 1);
+            for (const Segment& seg : prev)
+            {
+                TWindow intersect(seg.window);
+                step(intersect);
+                if (intersect.empty() && col.empty()) continue; // Windows are only shrinking to the left
+                if (!col.empty() && col.back().window == intersect) continue;
+                col.push_back(Segment{seg.start, std::move(intersect)});
+            }
+        }
+        TWindow intersect;
+        init(intersect);
+        if (col.empty() || !(col.back().window == intersect))
+            col.push_back(Segment{p, std::move(intersect)});
+
+        n_stored += col.size();
+        n_peak = std::max(n_peak, n_stored);
+        columns.push_back(std::move(col));
+    }
+
+    /**
+     * @brief Drop all columns starting from position n
+     */
+    void truncate(std::size_t n)
+    {
+        for (std::size_t p = n; p < columns.size(); p++) n_stored -= columns[p].size();
+        columns.erase(columns.begin() + n, columns.end());
+    }
+};
+
+
+/**
+ * @brief Bounded memo of the parser decisions, which is built lazily during parsing. Each state is keyed by the signature of the stack suffix which may be reduced and the lookahead symbol
+ * @tparam TDecision Decision taken in the state
+ */
+template<class TDecision>
+class LazyAutomaton
+{
+protected:
+    struct SignatureHash
+    {
+        std::size_t operator()(const std::vector<std::size_t>& key) const noexcept
+        {
+            std::size_t h = key.size();
+            for (const std::size_t k : key) h ^= k + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+
+    std::unordered_map<std::vector<std::size_t>, TDecision, SignatureHash> states;
+    std::unordered_map<std::vector<std::size_t>, std::size_t, SignatureHash> token_classes; ///< Tokens with equal signatures share the class
+    std::vector<std::size_t> token_ids; ///< Class of each input token in the current run
+    std::vector<std::size_t> lookahead_ids; ///< Class of each input token as the lookahead symbol, ditto
+    std::vector<std::size_t> signature; ///< Scratch signature of a token
+    std::size_t max_states;
+    std::size_t n_hits = 0, n_misses = 0;
+
+public:
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    std::vector<std::size_t> key; ///< Signature of the current state
+
+    explicit LazyAutomaton(std::size_t capacity = 1 << 16) : max_states(capacity) {}
+
+    /**
+     * @brief Prepare the token classes for a new input
+     */
+    void begin(std::size_t n_tokens)
+    {
+        token_ids.assign(n_tokens, npos);
+        lookahead_ids.assign(n_tokens, npos);
+    }
+
+    /**
+     * @brief Add the classes of the tokens appended to the input
+     */
+    void extend(std::size_t n_tokens)
+    {
+        token_ids.resize(n_tokens, npos);
+        lookahead_ids.resize(n_tokens, npos);
+    }
+
+    /**
+     * @brief Drop the classes of the first n input tokens, the rest are moved to the front
+     */
+    void drop(std::size_t n)
+    {
+        token_ids.erase(token_ids.begin(), token_ids.begin() + static_cast<std::ptrdiff_t>(n));
+        lookahead_ids.erase(lookahead_ids.begin(), lookahead_ids.begin() + static_cast<std::ptrdiff_t>(n));
+    }
+
+    /**
+     * @brief Get the class of the input token
+     * @param lookahead The token is classed as the lookahead symbol
+     * @param describe Callback which writes the token signature into a vector of ids
+     */
+    template<class Describe>
+    std::size_t token_class(std::size_t i, bool lookahead, Describe&& describe)
+    {
+        std::size_t& id = lookahead ? lookahead_ids[i] : token_ids[i];
+        if (id != npos) return id;
+        signature.clear();
+        describe(signature);
+        const auto it = token_classes.find(signature);
+        if (it != token_classes.end()) return id = it->second;
+        return id = token_classes.emplace(signature, token_classes.size()).first->second;
+    }
+
+    /**
+     * @brief Look up the decision of the current state, nullptr if the state was not visited yet
+     */
+    const TDecision* find()
+    {
+        const auto it = states.find(key);
+        if (it == states.end())
+        {
+            n_misses++;
+            return nullptr;
+        }
+        n_hits++;
+        return &it->second;
+    }
+
+    /**
+     * @brief Store the decision of the current state. A full automaton keeps serving its states and the new ones are not stored
+     */
+    void insert(const TDecision& decision)
+    {
+        if (states.size() < max_states) states.emplace(key, decision);
+    }
+
+    void clear()
+    {
+        states.clear();
+        token_classes.clear();
+        std::fill(token_ids.begin(), token_ids.end(), npos);
+        std::fill(lookahead_ids.begin(), lookahead_ids.end(), npos);
+    }
+
+    void set_capacity(std::size_t capacity) { max_states = capacity; }
+
+    [[nodiscard]] std::size_t size() const { return states.size(); }
+
+    [[nodiscard]] std::size_t hits() const { return n_hits; }
+
+    [[nodiscard]] std::size_t misses() const { return n_misses; }
+
+    [[nodiscard]] double hit_ratio() const { return n_hits + n_misses == 0 ? 0.0 : static_cast<double>(n_hits) / static_cast<double>(n_hits + n_misses); }
+};
+
+
 template<class VStr, class TokenType, class TokenTSet, class Tree, std::size_t STACK_MAX, class RulesSymbol, class RRTree, class SymbolsHT, class TermsMap, std::uint64_t Conf, class Lookahead, class RChecker, class CtxMgr, class TPrinter>
 class SRParser
 {
@@ -383,29 +631,193 @@ public:
     Lookahead look;
     RChecker r_checker;
     CtxMgr ctx_mgr;
+    static constexpr std::size_t n_types = cfg_helpers::type_bits_count<TokenType, SymbolsHT>();
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+    using TypeBits = TypeBitset<n_types>;
+    using LookaheadRow = typename Lookahead::FollowRow; // Nterm ids of the lookahead types
+
+    /**
+     * @brief Number of the tokens after the stack which are checked before a reduction, at least one
+     */
+    static constexpr std::size_t lookahead_depth() { return Lookahead::depth; }
+
+    /**
+     * @brief Common types of a stack window. Candidates follow the types order of the symbol which cropped the window last
+     */
+    struct WindowTypes
+    {
+        TypeBits bits;
+        CompactSymbol order;
+
+        [[nodiscard]] bool empty() const { return bits.empty(); }
+
+        bool operator==(const WindowTypes& rhs) const = default;
+    };
+
+    /**
+     * @brief Nonterminals which contain the nterm, in the order of the reverse rules tree
+     */
+    struct RelatedTypes
+    {
+        TypeBits bits;
+        std::vector<TokenType> types;
+        std::vector<std::size_t> ids;
+    };
+
+    std::vector<TokenTSet> nterm_types; // Types of the reduced stack symbols, indexed by the nterm id
+    std::vector<RelatedTypes> nterm_related; // ditto
+    std::unordered_map<TokenType, std::size_t> nterm_ids;
+    std::unordered_map<TokenType, std::size_t> type_ids; // Bit index of each type, SymbolId is used directly
+    std::vector<TokenType> run_nterms; // Nterms defined as a Repeat over single characters, which are the only type of a coalesced run token
+
+    using RuleBits = TypeBitset<std::tuple_size_v<typename RulesSymbol::term_types_tuple>>; // One bit per defined nterm id
+    HandleAutomaton handle_automaton; // Reversed rules, only built with SRConfEnum::HandleAutomaton or SRConfEnum::LazyAutomaton
+    RuleBits opaque_rules; // Rules which are not compiled into the automaton
+
+    std::unordered_map<std::string_view, std::size_t> term_values; // Id of each term value, only built with SRConfEnum::LazyAutomaton
+    std::array<std::size_t, 256> char_classes{}; // Characters which pass the same ranges and term characters share the class, ditto
+
+    /**
+     * @brief Rules whose match may end with each stack symbol : [0, 256) are the first characters of tokens, [256, n_bits) are nterm ids.
+     * Rules which may end with any symbol are set in each entry
+     */
+    static constexpr auto closing_rules = []{
+        constexpr std::size_t n_bits = 256 + std::tuple_size_v<typename RulesSymbol::term_types_tuple>;
+        std::array<RuleBits, n_bits> table{};
+        [&]<class... Defs>(const std::tuple<Defs...>*){
+            ([&]{
+                constexpr std::size_t id = cfg_helpers::defined_nterm_id<get_first_t<Defs>, RulesSymbol>();
+                constexpr const auto& bounds = RuleProgram<std::decay_t<get_second_t<Defs>>, RulesSymbol>::bounds;
+                for (std::size_t b = 0; b < n_bits; b++)
+                    if (bounds.any_last || bounds.last.test(b)) table[b].set(id);
+            }(), ...);
+        }(static_cast<const typename RulesSymbol::term_types_tuple*>(nullptr));
+        return table;
+    }();
+
+    /**
+     * @brief Reduce decision of a parser state. The window start is relative to the lowest window which may be reduced
+     */
+    struct ReduceDecision
+    {
+        std::size_t window;
+        TokenType type;
+    };
+
+    using Stack = SymbolStack<VStr, TokenTSet>;
+
+    /**
+     * @brief Mutable state of a parser run. The parser itself is only read during parsing, so one parser may serve several threads, each with its own session
+     */
+    struct ParseSession
+    {
+        RChecker r_checker; // Context of RC(1)
+        CtxMgr ctx_mgr; // Context of the ContextManager
+        IntersectCache<WindowTypes> intersect_cache;
+        ConstVec<TokenType> candidates; // Common types of the current window
+        LazyAutomaton<ReduceDecision> automaton;
+        std::vector<RuleBits> handles{}; // Rules which may match each window, relative to the first visited window
+        HandleAutomaton::Scratch handles_scratch{};
+        Stack stack{}; // Reused between the runs of the session
+    };
 
     using TokenV = Token<VStr, TokenTSet>;
     using GSymbolV = GrammarSymbol<VStr, TokenTSet>;
+    using GSymbolRef = GrammarSymbolRef<VStr, TokenTSet>;
+
+    constexpr explicit SRParser(const RulesSymbol& rules, const RRTree& rr_tree, const SymbolsHT& ht, const TermsMap& t_map, SRParserConfig<Conf> conf, const Lookahead& lookahead, const RChecker& checker, const CtxMgr& h_ctx) : symbols_ht(ht), terms_storage(t_map), reverse_rules(rr_tree), defs(rules), conf(conf), look(lookahead), r_checker(checker), ctx_mgr(h_ctx)
+    {
+        if constexpr (!is_symbol_id_v<TokenType>)
+        {
+            // Assign a bit to each type
+            for (const auto& type : symbols_ht.nterms_map.keys) type_ids.insert({type, type_ids.size()});
+            for (const auto& type : symbols_ht.terms_map.keys) type_ids.try_emplace(type, type_ids.size());
+            assert(type_ids.size() <= n_types && "SRParser() : guru meditation : grammar has more types than expected");
+        }
+
+        run_nterms = repeat_run_nterms<TokenType>(rules);
+
+        // Assign an id to each defined nterm
+        [&]<class... Defs>(const std::tuple<Defs...>*){ (add_nterm_type(TokenType(typename get_first<Defs>::type().type())), ...); }(static_cast<const typename RulesSymbol::term_types_tuple*>(nullptr));
+        if constexpr (enabled<SRConfEnum::Lookahead>())
+            assert(nterm_types.size() == LookaheadRow::capacity() && "SRParser() : guru meditation : FOLLOW matrix ids differ from the nterm ids");
+
+        if constexpr (scans_handles())
+        {
+            [&]<class... Defs>(const std::tuple<Defs...>*){
+                (handle_automaton.add_rule(cfg_helpers::defined_nterm_id<get_first_t<Defs>, RulesSymbol>(), RuleProgram<std::decay_t<get_second_t<Defs>>, RulesSymbol>::ops.data()), ...);
+            }(static_cast<const typename RulesSymbol::term_types_tuple*>(nullptr));
+            for (const auto rule : handle_automaton.opaque_rules()) opaque_rules.set(rule);
+        }
+
+        if constexpr (memoized())
+        {
+            // Token values are only compared by the terms and the ranges of the rules
+            std::vector<std::pair<char, char>> char_tests;
+            [&]<class... Defs>(const std::tuple<Defs...>*){
+                (add_value_tests(RuleProgram<std::decay_t<get_second_t<Defs>>, RulesSymbol>::ops, char_tests), ...);
+            }(static_cast<const typename RulesSymbol::term_types_tuple*>(nullptr));
+
+            std::unordered_map<std::vector<bool>, std::size_t> patterns;
+            for (std::size_t c = 0; c < char_classes.size(); c++)
+            {
+                std::vector<bool> pattern;
+                for (const auto& [start, end] : char_tests) pattern.push_back(in_lexical_range<char>(static_cast<char>(c), start, end));
+                char_classes[c] = patterns.try_emplace(std::move(pattern), patterns.size()).first->second;
+            }
+        }
+    }
 
-    constexpr explicit SRParser(const RulesSymbol& rules, const RRTree& rr_tree, const SymbolsHT& ht, const TermsMap& t_map, SRParserConfig<Conf> conf, const Lookahead& lookahead, const RChecker& checker, const CtxMgr& h_ctx) : symbols_ht(ht), terms_storage(t_map), reverse_rules(rr_tree), defs(rules), conf(conf), look(lookahead), r_checker(checker), ctx_mgr(h_ctx) {}
+    /**
+     * @brief Create a new parse session, which holds the context of a single run
+     */
+    [[nodiscard]] ParseSession make_session() const
+    {
+        return ParseSession{r_checker, ctx_mgr, IntersectCache<WindowTypes>(), ConstVec<TokenType>(0, n_types), LazyAutomaton<ReduceDecision>()};
+    }
     // Construct reverse tree (mapping TokenType -> tuple(NTerms)), in which nterms is it contained
 
     template<class RootSymbol>
-    bool run(Tree& node, const RootSymbol& root, std::vector<TokenV>& tokens)
+    bool run(Tree& node, const RootSymbol& root, std::vector<TokenV>& tokens) const
     {
         TPrinter printer;
         return run(node, root, tokens, printer);
     }
 
+    /**
+     * @brief Run with a new session, which is dropped afterwards
+     */
+    template<class RootSymbol>
+    bool run(Tree& node, const RootSymbol& root, std::vector<TokenV>& tokens, TPrinter& printer) const
+    {
+        ParseSession s = make_session();
+        return run(node, root, tokens, s, printer);
+    }
+
+    /**
+     * @brief Reentrant run, all mutable state is stored in the session
+     */
     template<class RootSymbol>
-    bool run(Tree& node, const RootSymbol& root, std::vector<TokenV>& tokens, TPrinter& printer)
+    bool run(Tree& node, const RootSymbol& root, std::vector<TokenV>& tokens, ParseSession& s) const
+    {
+        TPrinter printer;
+        return run(node, root, tokens, s, printer);
+    }
+
+    template<class RootSymbol>
+    bool run(Tree& node, const RootSymbol& root, std::vector<TokenV>& tokens, ParseSession& s, TPrinter& printer) const
     {
         if constexpr (enabled<SRConfEnum::ReducibilityChecker>())
-            r_checker.reset_ctx();
+            s.r_checker.reset_ctx();
         if constexpr (enabled<SRConfEnum::HeuristicCtx>())
-            ctx_mgr.reset_ctx();
+            s.ctx_mgr.reset_ctx();
+        s.intersect_cache.reset();
+        if constexpr (memoized())
+            s.automaton.begin(tokens.size());
         // Initialize point at zero
-        std::vector<GSymbolV> stack{GSymbolV(tokens[0].value, tokens[0].type)};
+        Stack& stack = s.stack;
+        stack.reset(tokens, nterm_types);
+        shift(stack, &node, tokens, 0);
         std::size_t i = 1;
 
         while (true) //(i < tokens.size())
@@ -415,9 +827,9 @@ public:
                 // CtxManager analyzes the symbols which cannot be reduced right away
                 // Take the last symbol and try resolving context
 
-                auto tok = stack.back();
+                CompactSymbol tok = stack.entry(stack.size() - 1);
 
-                for (std::size_t j = 0; !ctx_mgr.next(tok, stack, symbols_ht, printer); j++)
+                for (std::size_t j = 0; !s.ctx_mgr.next(stack.resolve(tok), stack, symbols_ht, printer); j++)
                 {
                     while (!printer.process_at_heur_ctx()) {}
                     // Ambiguity found, move tok
@@ -427,20 +839,20 @@ public:
                         return false;
                     }
                     // TODO replace Token class with GSymbol
-                    tok = GSymbolV(tokens[j].value, tokens[j].type); // take the next term from the tokens
+                    tok = CompactSymbol::make_token(j); // take the next term from the tokens
                 }
                 while (!printer.process_at_heur_ctx()) {}
                 // ambiguity resolved
             }
 
-            if (!reduce_lookahead_runtime(stack, &node, tokens, i, printer))
+            if (!reduce_lookahead_runtime(s, stack, &node, tokens, i, printer))
             {
                 // Shift operation
                 if (i == tokens.size()) [[unlikely]]
                     //return false;
                     break;
 
-                stack.push_back(GSymbolV(tokens[i].value, tokens[i].type));
+                shift(stack, &node, tokens, i);
                 i++;
                 //if constexpr (enabled<SRConfEnum::PrettyPrint>()) std::cout << "[sh] s: [";
             } //else if constexpr (enabled<SRConfEnum::PrettyPrint>()) std::cout << "[re] s: [";
@@ -452,6 +864,126 @@ public:
         return false;
     }
 
+    /**
+     * @brief Push-based run over a token stream. Tokens are shifted and reduced as they arrive, the last token is held back as the lookahead
+     * @tparam OnItem Callback which receives the tree of each completed top-level item
+     */
+    template<class OnItem>
+    class StreamSession
+    {
+    protected:
+        const SRParser& parser;
+        ParseSession s;
+        OnItem on_item;
+        std::vector<TokenV> tokens; // Tokens of the current item and the lookahead
+        Stack stack;
+        std::size_t i = 0; // Next token to shift
+        std::size_t root_id;
+        bool cut; // Items are only split if the root symbol is not contained in other rules
+        Tree tree;
+        TPrinter printer;
+
+    public:
+        StreamSession(const SRParser& p, std::size_t root_id, OnItem on_item) : parser(p), s(p.make_session()), on_item(std::move(on_item)), tokens(), stack(tokens, p.nterm_types), root_id(root_id), cut(p.nterm_related[root_id].types.empty())
+        {
+            static_assert(!enabled<SRConfEnum::HeuristicCtx>(), "StreamSession : HeuristicCtx looks up arbitrary tokens and is not supported");
+            if constexpr (enabled<SRConfEnum::ReducibilityChecker>())
+                s.r_checker.reset_ctx();
+            if constexpr (memoized())
+                s.automaton.begin(0);
+        }
+
+        // The stack points to the tokens storage
+        StreamSession(const StreamSession&) = delete;
+        StreamSession& operator=(const StreamSession&) = delete;
+
+        /**
+         * @brief Append the next chunk of tokens and parse as far as the lookahead allows. The last lookahead_depth() tokens are held back
+         */
+        void feed(const std::vector<TokenV>& chunk)
+        {
+            tokens.insert(tokens.end(), chunk.begin(), chunk.end());
+            stack.rebind(tokens);
+            if constexpr (memoized())
+                s.automaton.extend(tokens.size());
+            step(false);
+        }
+
+        /**
+         * @brief Parse the rest of the stream. Returns true if all items were reduced to the root symbol
+         */
+        bool finish()
+        {
+            step(true);
+            if (stack.empty()) return true;
+            if (!is_item()) return false;
+            emit();
+            return true;
+        }
+
+        /**
+         * @brief Number of the buffered tokens, which are not released yet
+         */
+        [[nodiscard]] std::size_t buffered() const { return tokens.size(); }
+
+    protected:
+        void step(bool last)
+        {
+            while (i + lookahead_depth() <= tokens.size() || last)
+            {
+                if (stack.empty())
+                {
+                    if (i == tokens.size()) break;
+                    parser.shift(stack, &tree, tokens, i);
+                    i++;
+                    continue;
+                }
+
+                if (!parser.reduce_lookahead_runtime(s, stack, &tree, tokens, i, printer))
+                {
+                    // Shift operation
+                    if (i == tokens.size()) break;
+
+                    // The root cannot be reduced further, release the item
+                    if (cut && is_item()) emit();
+
+                    parser.shift(stack, &tree, tokens, i);
+                    i++;
+                }
+            }
+        }
+
+        [[nodiscard]] bool is_item() const { return stack.size() == 1 && !stack.entry(0).token && stack.entry(0).index == root_id; }
+
+        void emit()
+        {
+            on_item(tree);
+            if constexpr (!is_tree_builder_v<Tree>)
+                tree = Tree();
+            stack.truncate(0);
+            s.intersect_cache.reset();
+            if constexpr (enabled<SRConfEnum::ReducibilityChecker>())
+                s.r_checker.reset_ctx();
+            if constexpr (memoized())
+                s.automaton.drop(i);
+            // Only the tokens after the item are kept
+            tokens.erase(tokens.begin(), tokens.begin() + static_cast<std::ptrdiff_t>(i));
+            stack.rebind(tokens);
+            i = 0;
+        }
+    };
+
+    /**
+     * @brief Create a push-based session over this parser, which should outlive it
+     * @param root Symbol of the top-level items
+     * @param on_item Callback, which is called with the tree of each completed item. The tree is reset afterwards
+     */
+    template<class RootSymbol, class OnItem>
+    [[nodiscard]] auto make_stream_session(const RootSymbol& root, OnItem on_item) const
+    {
+        return std::make_unique<StreamSession<OnItem>>(*this, nterm_id(TokenType(root.type())), std::move(on_item));
+    }
+
 protected:
     void prettyprint(std::vector<GSymbolV>& stack, std::size_t start = 0) const
     {
@@ -597,23 +1129,106 @@ protected:
         return false;
     }
 
-    bool reduce_lookahead_runtime(std::vector<GSymbolV>& stack, Tree* root, const std::vector<TokenV>& tokens, std::size_t tokens_ind, TPrinter& printer)
+    void add_nterm_type(const TokenType& type)
+    {
+        if (nterm_ids.contains(type)) return;
+        nterm_ids.insert({type, nterm_types.size()});
+        nterm_types.push_back(TokenTSet(type));
+
+        RelatedTypes related;
+        symbols_ht.get_nterm(type, [&](const auto& nterm){
+            tuple_each(reverse_rules.get(nterm), [&](std::size_t l, const auto& t){
+                related.types.push_back(TokenType(t.type()));
+                related.ids.push_back(type_id(related.types.back()));
+                if (related.ids.back() < n_types) related.bits.set(related.ids.back());
+            });
+        });
+        nterm_related.push_back(std::move(related));
+    }
+
+    /**
+     * @brief Get the bit index of a type, npos if the type is not present in the grammar
+     */
+    std::size_t type_id(const TokenType& type) const
+    {
+        if constexpr (is_symbol_id_v<TokenType>)
+            return type.id < n_types ? type.id : npos;
+        else
+        {
+            const auto it = type_ids.find(type);
+            return it != type_ids.end() ? it->second : npos;
+        }
+    }
+
+    /**
+     * @brief Types of the stack symbol. Tokens yield their own types, nterms yield the related types
+     */
+    TypeBits symbol_bits(const Stack& stack, const CompactSymbol& s) const
+    {
+        if (!s.token) return nterm_related[s.index].bits;
+
+        TypeBits bits;
+        const auto& types = stack.resolve(s).type;
+        for (std::size_t l = 0; l < types.size(); l++)
+        {
+            const std::size_t id = type_id(types[l]);
+            if (id < n_types) bits.set(id);
+        }
+        return bits;
+    }
+
+    /**
+     * @brief List the common types of the window into the candidates array
+     */
+    void window_candidates(ParseSession& s, const Stack& stack, const WindowTypes& window) const
     {
+        ConstVec<TokenType>& candidates = s.candidates;
+        candidates.erase();
+        if (window.empty()) return;
+
+        if (window.order.token)
+        {
+            const auto& types = stack.resolve(window.order).type;
+            for (std::size_t l = 0; l < types.size(); l++)
+            {
+                const std::size_t id = type_id(types[l]);
+                if (id < n_types && window.bits.test(id)) candidates += types[l];
+            }
+        } else {
+            const RelatedTypes& related = nterm_related[window.order.index];
+            for (std::size_t l = 0; l < related.types.size(); l++)
+                if (related.ids[l] < n_types && window.bits.test(related.ids[l])) candidates += related.types[l];
+        }
+    }
+
+    /**
+     * @brief Get the id of a defined nterm, which is stored in the stack
+     */
+    std::size_t nterm_id(const TokenType& type) const { return nterm_ids.find(type)->second; }
+
+    bool reduce_lookahead_runtime(ParseSession& s, Stack& stack, Tree* root, const std::vector<TokenV>& tokens, std::size_t tokens_ind, TPrinter& printer) const
+    {
+        // Steps where no handle may end at the top of the stack are shifted right away
+        if constexpr (shift_only_enabled())
+        {
+            if (shift_only(stack, tokens, tokens_ind)) return false;
+        }
+
         if constexpr (enabled<SRConfEnum::Lookahead>())
         {
             if (tokens_ind != tokens.size()) [[likely]]
             {
                 //if constexpr (enabled<SRConfEnum::PrettyPrint>())
                 //    std::cout << "l: " << tokens[tokens_ind].type << std::endl;
-                return reduce_runtime(stack, root, tokens, tokens_ind, tokens[tokens_ind].type, printer);
+                return reduce_runtime(s, stack, root, tokens, tokens_ind, tokens[tokens_ind].type, printer);
             }
             // Disable lookahead check
-            return reduce_runtime(stack, root, tokens, tokens_ind, std::false_type(), printer);
-        } else return reduce_runtime(stack, root, tokens, tokens_ind, std::false_type(), printer);
+            return reduce_runtime(s, stack, root, tokens, tokens_ind, std::false_type(), printer);
+        } else return reduce_runtime(s, stack, root, tokens, tokens_ind, std::false_type(), printer);
     }
 
     template<class LookaheadS>
-    bool reduce_runtime(std::vector<GSymbolV>& stack, Tree* root, const std::vector<TokenV>& tokens, std::size_t tokens_ind, const LookaheadS& lookahead, TPrinter& printer)
+    bool reduce_runtime(ParseSession& s, Stack& stack, Tree* root, const std::vector<TokenV>& tokens, std::size_t tokens_ind, const LookaheadS& lookahead, TPrinter& printer) const
     {
         // First loop over the stack
         // Greedy mode: check longer substr first
@@ -644,99 +1259,73 @@ protected:
             }
         }
 
-        for (std::int64_t i = 0; i < stack.size(); i++)
+        // Sync the intersections cache with the shifted symbols
+        while (s.intersect_cache.size() < stack.size())
         {
-            // Efficient vector of common types
-            ConstVec<TokenType> intersect;
-            // First element (optimized j=0)
-            const GSymbolV& first = stack[i];
-            if (first.is_token())
-            {
-                // Size of the set will be N symbols where it is present
-                if constexpr (TokenTSet::is_singleton())
-                    intersect.init(first.type);
-                else
-                    intersect.init(first.type.vec());
-            } else {
-                //intersect.push_back(reverse_rules_ht[first.type]);
+            const CompactSymbol elem = stack.entry(s.intersect_cache.size());
+            const TypeBits bits = symbol_bits(stack, elem);
+            s.intersect_cache.push([&](WindowTypes& window){ window.bits = bits; window.order = elem; },
+                                 [&](WindowTypes& window){
+                                     window.bits &= bits;
+                                     if (elem.token) window.order = elem; // Tokens reorder the common types, nterms preserve the order
+                                 });
+        }
 
-                // Size of the set will be no greater than the related element
-                symbols_ht.get_nterm(first.type.front(), [&](const auto& nterm){
-                    // Tuple of related elements
-                    const auto& related_types = tuple_morph([&]<std::size_t k>(const auto& rr){ return TokenType(std::get<k>(rr).type()); }, reverse_rules.get(nterm));
-                    intersect.init(related_types);
-                });
-            }
+        // Windows below the first cached position have no common types. They are only visited for prettyprinting
+        std::int64_t first_window = enabled<SRConfEnum::PrettyPrint>() ? 0 : s.intersect_cache.first();
+        // Windows longer than any rule are skipped
+        if constexpr (!enabled<SRConfEnum::PrettyPrint>() && max_rule_len() != RuleBounds<1>::unbounded)
+        {
+            if (stack.size() > max_rule_len())
+                first_window = std::max<std::int64_t>(first_window, stack.size() - max_rule_len());
+        }
 
-            // Loop over the window
-            for (std::int64_t j = i + 1; j < stack.size(); j++)
+        auto key_start = static_cast<std::size_t>(first_window); // Lowest window which may be reduced
+        if constexpr (scans_handles())
+        {
+            // One pass from the top of the stack reports all windows which may be reduced
+            s.handles.assign(stack.size() - first_window, RuleBits());
+            std::size_t lowest = stack.size();
+            handle_automaton.scan(stack, first_window, s.handles_scratch, [&](std::size_t start, std::size_t rule){
+                s.handles[start - first_window].set(rule);
+                lowest = std::min(lowest, start);
+            });
+            if (opaque_rules.empty()) key_start = lowest;
+        }
+
+        if constexpr (memoized())
+        {
+            // The decision only depends on the windows which may be reduced and the lookahead symbol
+            if (key_start == stack.size()) return false;
+            automaton_signature(s, stack, key_start, tokens, tokens_ind, lookahead);
+            if (const ReduceDecision* decision = s.automaton.find())
             {
-                if (intersect.size() == 0) break;
-                const GSymbolV& elem = stack[j];
+                if (decision->window == npos) return false;
+                reduce_window(s, stack, root, key_start + decision->window, decision->type, printer);
+                return true;
+            }
+        }
 
-                if (elem.is_token())
-                {
-                    if constexpr (TokenTSet::is_singleton())
-                    {
-                        // Find intersection with token - only a single type
-                        [&]{
-                            for (std::size_t k = 0; k < intersect.size(); k++)
-                            {
-                                if (intersect[k] == elem.type)
-                                {
-                                    intersect.replace_with(elem.type);
-                                    return; // Success
-                                }
-                            }
-                            intersect.erase(); // Failure
-                        }();
-                    } else {
-                        // We need to iterate over all types
-                        std::size_t found = 0;
-                        for (std::size_t l = 0; l < elem.type.size(); l++)
-                        {
-                            // Iterate over the set
-                            for (std::size_t k = found; k < intersect.size(); k++)
-                            {
-                                if (intersect[k] == elem.type[l])
-                                {
-                                    // Move to the beginning
-                                    std::swap(intersect[found], intersect[k]); // We assume that same element swap is safe
-                                    found++;
-                                }
-                            }
-                        }
-                        // Crop the array to the new size
-                        intersect.set_size(found);
-                    }
+        // Types of the next tokens which may continue a match, they prevent partial reductions
+        LookaheadRow next_types{};
+        bool next_known = true;
+        if constexpr (enabled<SRConfEnum::Lookahead>() && !std::is_same_v<std::decay_t<LookaheadS>, std::false_type>)
+            next_types = lookahead_types(tokens, tokens_ind, next_known);
 
-                } else {
-                    // Size of the set will be not greater than the related element
-                    symbols_ht.get_nterm(elem.type.front(), [&](const auto& nterm){
-                        // Tuple of related elements
-                        const auto& related_types = reverse_rules.get(nterm);
-
-                        // Number of elements already found. Matching elements are pushed to the beginning of the array
-                        std::size_t found = 0;
-                        // Iterate over the set
-                        for (std::size_t k = 0; k < intersect.size(); k++)
-                        {
-                            tuple_each(related_types, [&](std::size_t l, const auto& t){
-                                // Found
-                                if (intersect[k] == t.type())
-                                {
-                                    // Move to the beginning
-                                    std::swap(intersect[found], intersect[k]); // We assume that same element swap is safe
-                                    found++;
-                                }
-                            });
-                        }
-                        // Crop the array to the new size
-                        intersect.set_size(found);
-                    });
-                }
+        for (std::int64_t i = first_window; i < stack.size(); i++)
+        {
+            if constexpr (scans_handles())
+            {
+                if (s.handles[i - first_window].empty() && opaque_rules.empty()) continue; // No rule may match the window
             }
 
+            // Common types of the window [i, top]
+            if (i < s.intersect_cache.first())
+                s.candidates.erase();
+            else
+                window_candidates(s, stack, s.intersect_cache.get(i));
+            const ConstVec<TokenType>& intersect = s.candidates;
+
             /*if constexpr (enabled<SRConfEnum::PrettyPrint>())
             {
                 std::cout << "  " << "s: [";
@@ -768,7 +1357,7 @@ protected:
                     // It is cheaper to perform context check now
                     if constexpr (enabled<SRConfEnum::HeuristicCtx>())
                     {
-                        if (!ctx_mgr.check_ctx(match, printer))
+                        if (!s.ctx_mgr.check_ctx(match, printer))
                             return false; // not allowed in current ctx
                     }
 
@@ -778,7 +1367,20 @@ protected:
 
                     std::size_t index = 0;
 
-                    bool success = descend_batch_runtime(stack, i, def, index, [](const auto&... args){});
+                    // The window length and its edge symbols are checked before running the rule. Every descend is shown in prettyprinting
+                    if constexpr (!enabled<SRConfEnum::PrettyPrint>())
+                    {
+                        if (!rule_bounds_admit(RuleProgram<std::decay_t<decltype(def)>, RulesSymbol>::bounds, stack, i))
+                            return false;
+                    }
+                    if constexpr (scans_handles())
+                    {
+                        constexpr std::size_t rule_id = cfg_helpers::defined_nterm_id<std::decay_t<decltype(match)>, RulesSymbol>();
+                        if (!s.handles[i - first_window].test(rule_id) && !opaque_rules.test(rule_id))
+                            return false;
+                    }
+
+                    bool success = match_rule(stack, i, def, index, [](const auto&... args){});
                     if constexpr (enabled<SRConfEnum::PrettyPrint>())
                     {
                         printer.update_descend(stack, rule, i, k, intersect.size(), index, success);
@@ -794,18 +1396,18 @@ protected:
                     {
                         // We need to check if at least one top-level rule will be able to reduce the stack
                         // This routine requires the stack to have the match to be applied
-                        std::vector<GSymbolV> stack_copy(stack.begin(), stack.begin() + i); // keep [0 - i-1]
-                        stack_copy.push_back(GSymbolV(TokenTSet(intersect[k])));
-                        bool ok = r_checker.can_reduce(match, stack_copy.size(), defs, [&](std::size_t index_stack, const auto& def_r){
+                        Stack stack_copy = stack.prefix(i); // keep [0 - i-1]
+                        stack_copy.push_back(CompactSymbol::make_nterm(nterm_id(intersect[k])));
+                        bool ok = s.r_checker.can_reduce(match, stack_copy.size(), defs, [&](std::size_t index_stack, const auto& def_r){
                             std::size_t index_check = 0, index_check_max = 0;
-                            descend_batch_runtime(stack_copy, index_stack, def_r, index_check, [&](const std::size_t ind, bool match_ok){
+                            match_rule(stack_copy, index_stack, def_r, index_check, [&](const std::size_t ind, bool match_ok){
                                 // Handle lost index
                                 if (ind > index_check_max) index_check_max = ind;
                             });
                             return std::max(index_check, index_check_max);
                         });
 
-                        r_checker.apply_ctx(); // Apply the context
+                        s.r_checker.apply_ctx(); // Apply the context
                         if (!ok)
                         {
                             //std::cout << "  rc(1) doesn't allow to reduce" << std::endl;
@@ -816,55 +1418,254 @@ protected:
                     // Check lookahead symbol
                     if constexpr (enabled<SRConfEnum::Lookahead>() && !std::is_same_v<std::decay_t<LookaheadS>, std::false_type>)
                     {
-                        // The next symbol is of the same type
-                        for (std::size_t l = 0; l < lookahead.size(); l++)
+                        // The next symbol may follow the match, the reduction would be partial
+                        constexpr std::size_t row = Lookahead::template nterm_id<std::decay_t<decltype(match)>>();
+                        if (!next_known || look.follows(row, next_types))
                         {
-                            if (!symbols_ht.get_nterm(lookahead[l], [&](const auto& nterm){ return look.can_reduce(match, nterm); }))
-                            {
-                                // No suitable symbol found
-                                //if constexpr (enabled<SRConfEnum::PrettyPrint>())
-                                //    std::cout << "^ look mismatch" << std::endl;
-                                return false; // Not found
-                            }
+                            //if constexpr (enabled<SRConfEnum::PrettyPrint>())
+                            //    std::cout << "^ look mismatch" << std::endl;
+                            return false;
                         }
                     }
 
                     if constexpr (enabled<SRConfEnum::ReducibilityChecker>())
-                        r_checker.apply_reduce(match); // If the matched symbol has context, we need to decrement
+                        s.r_checker.apply_reduce(match); // If the matched symbol has context, we need to decrement
                     if constexpr (enabled<SRConfEnum::HeuristicCtx>())
-                        ctx_mgr.apply_reduce(match, def, stack, i+1, printer); // ditto
+                        s.ctx_mgr.apply_reduce(match, def, stack, i+1, printer); // ditto
                     return true;
                 });
 
                 if (!found) continue;
 
-                // New node of the matched type
-                Tree new_node(intersect[k], root);
-                for (std::size_t j = i; j < stack.size(); ++j)
+                if constexpr (memoized())
+                    s.automaton.insert(ReduceDecision{static_cast<std::size_t>(i) - key_start, intersect[k]});
+                reduce_window(s, stack, root, i, intersect[k], printer);
+                return true; // Performed reduce, return to shift
+            }
+        }
+        if constexpr (memoized())
+            s.automaton.insert(ReduceDecision{npos, TokenType()});
+        return false;
+    }
+
+    /**
+     * @brief Replace the window [i, top] with the nterm of the given type and build its node
+     */
+    void reduce_window(ParseSession& s, Stack& stack, Tree* root, std::size_t i, const TokenType& type, TPrinter& printer) const
+    {
+        if constexpr (is_tree_builder_v<Tree>)
+            root->on_reduce(type, nterm_id(type), stack.window(i));
+        else if constexpr (is_flat_tree_v<Tree>)
+        {
+            // Nodes are built in place, the nterms of the window are the last root children
+            std::size_t n_nterms = 0;
+            decltype(Tree::Node::value) value;
+            for (std::size_t j = i; j < stack.size(); ++j)
+            {
+                if (stack[j].is_token())
+                    value += stack[j].value;
+                else n_nterms++;
+            }
+            root->reduce(type, n_nterms, std::move(value));
+        } else {
+            // New node of the matched type
+            Tree new_node(type, root);
+            for (std::size_t j = i; j < stack.size(); ++j)
+            {
+                if (stack[j].is_token())
+                    new_node.add_value(stack[j].value);
+                else
                 {
-                    if (stack[j].is_token())
-                        new_node.add_value(stack[j].value);
-                    else
-                    {
-                        // We need to move these nodes from root into the new element
-                        Tree& elem = root->nodes.back(); // Get the nterm from root
-                        elem.parent = &new_node; // It will be invalidated anyway!
-                        new_node.add(elem);
-                        root->nodes.erase(root->nodes.end() - 1); // Hella inefficient
-                    }
+                    // We need to move these nodes from root into the new element
+                    Tree& elem = root->nodes.back(); // Get the nterm from root
+                    elem.parent = &new_node; // It will be invalidated anyway!
+                    new_node.add(elem);
+                    root->nodes.erase(root->nodes.end() - 1); // Hella inefficient
                 }
-                // Insert the new node
-                root->add(new_node);
+            }
+            // Insert the new node
+            root->add(new_node);
+        }
 
-                stack.erase(stack.begin() + i, stack.end()); // May be inefficient
-                stack.push_back(GSymbolV(TokenTSet(intersect[k]))); // insert the matched nterm
+        stack.truncate(i);
+        stack.push_back(CompactSymbol::make_nterm(nterm_id(type))); // insert the matched nterm
 
-                if constexpr (enabled<SRConfEnum::PrettyPrint>())
-                    printer.update_ast(*root);
-                return true; // Performed reduce, return to shift
+        if constexpr (enabled<SRConfEnum::PrettyPrint>() && !is_tree_builder_v<Tree>)
+            printer.update_ast(*root);
+
+        s.intersect_cache.truncate(i); // Only the windows ending below i are still valid
+    }
+
+    /**
+     * @brief Push the input token onto the stack, tree builders receive the shift event
+     */
+    void shift(Stack& stack, Tree* root, const std::vector<TokenV>& tokens, std::size_t i) const
+    {
+        if constexpr (is_tree_builder_v<Tree>)
+            root->on_shift(tokens[i]);
+        stack.push_back(CompactSymbol::make_token(i));
+    }
+
+    /**
+     * @brief Get the types of the next token which may continue a match, see SimpleLookahead::continuation()
+     * @param known Set to false if a type of the next token is not a defined nterm, which prevents all reductions
+     */
+    LookaheadRow lookahead_types(const std::vector<TokenV>& tokens, std::size_t tokens_ind, bool& known) const
+    {
+        return look.continuation(std::min(lookahead_depth(), tokens.size() - tokens_ind), [&](std::size_t d, LookaheadRow& row){
+            const auto& types = tokens[tokens_ind + d].type;
+            for (std::size_t l = 0; l < types.size(); l++)
+            {
+                const auto it = nterm_ids.find(types[l]);
+                if (it != nterm_ids.end()) row.set(it->second);
+                else if (d == 0) known = false; // Not a defined nterm
             }
+        });
+    }
+
+    /**
+     * @brief Check if no reduction is possible on this step : no rule may end with the top symbol, or the lookahead prevents each rule which may
+     */
+    bool shift_only(const Stack& stack, const std::vector<TokenV>& tokens, std::size_t tokens_ind) const
+    {
+        if (stack.empty()) return false;
+        const CompactSymbol top = stack.entry(stack.size() - 1);
+        std::size_t key = 256 + top.index;
+        if (top.token)
+        {
+            const VStr& value = stack.resolve(top).value;
+            if (value.empty()) return false; // Empty tokens are admitted by any rule
+            key = static_cast<unsigned char>(value[0]);
         }
-        return false;
+        const RuleBits& rules = closing_rules[key];
+        if (rules.empty()) return true;
+
+        // RC(1) updates its context on each matched window, even if the lookahead then prevents the reduction
+        if constexpr (enabled<SRConfEnum::Lookahead>() && !enabled<SRConfEnum::ReducibilityChecker>())
+        {
+            if (tokens_ind == tokens.size()) return false; // No lookahead at the end of input
+            bool known = true;
+            const LookaheadRow next = lookahead_types(tokens, tokens_ind, known);
+            if (!known) return true;
+            for (std::size_t r = 0; r < LookaheadRow::capacity(); r++)
+                if (rules.test(r) && !look.follows(r, next)) return false;
+            return true;
+        }
+        else return false;
+    }
+
+    /**
+     * @brief Write the signature of the current parser state into the automaton key : the stack symbols from key_start, then the lookahead tokens.
+     * Tokens are encoded by their class, nterms by their id
+     */
+    template<class LookaheadS>
+    void automaton_signature(ParseSession& s, const Stack& stack, std::size_t key_start, const std::vector<TokenV>& tokens, std::size_t tokens_ind, const LookaheadS& lookahead) const
+    {
+        auto& automaton = s.automaton;
+        automaton.key.clear();
+        automaton.key.push_back(stack.size() - key_start);
+        for (std::size_t j = key_start; j < stack.size(); j++)
+            automaton.key.push_back(automaton_symbol(automaton, stack, stack.entry(j), false));
+
+        if constexpr (enabled<SRConfEnum::Lookahead>() && !std::is_same_v<std::decay_t<LookaheadS>, std::false_type>)
+        {
+            const std::size_t n = std::min(lookahead_depth(), tokens.size() - tokens_ind);
+            for (std::size_t d = 0; d < n; d++)
+                automaton.key.push_back(automaton_symbol(automaton, stack, CompactSymbol::make_token(tokens_ind + d), true));
+            if (n < lookahead_depth()) automaton.key.push_back(npos); // End of input
+        }
+        else
+            automaton.key.push_back(npos);
+    }
+
+    /**
+     * @brief Id of a stack symbol in the automaton key. Tokens are classed by their types and by the part of the value which the rules compare, lookahead tokens by their types only
+     */
+    std::size_t automaton_symbol(LazyAutomaton<ReduceDecision>& automaton, const Stack& stack, const CompactSymbol& sym, bool lookahead) const
+    {
+        if (!sym.token) return sym.index * 2 + 1;
+        return automaton.token_class(sym.index, lookahead, [&](std::vector<std::size_t>& sig){
+            const GSymbolRef ref = stack.resolve(sym);
+            sig.push_back(lookahead);
+            sig.push_back(ref.type.size());
+            for (std::size_t l = 0; l < ref.type.size(); l++) sig.push_back(type_id(ref.type[l]));
+            if (!lookahead) value_signature(ref.value, sig);
+        }) * 2;
+    }
+
+    /**
+     * @brief Append the value part of a token signature : the id of a term value, or the size tag and the classes of the characters otherwise.
+     * Other values fail each term, ranges only match single characters, and the characters of a coalesced run are matched one by one
+     */
+    void value_signature(const VStr& value, std::vector<std::size_t>& sig) const
+    {
+        if constexpr (sizeof(typename VStr::value_type) == 1)
+        {
+            const std::string_view view(reinterpret_cast<const char*>(value.data()), value.size());
+            if (const auto it = term_values.find(view); it != term_values.end())
+            {
+                sig.push_back(0);
+                sig.push_back(it->second);
+                return;
+            }
+            sig.push_back(1 + std::min<std::size_t>(value.size(), 2)); // Empty, single character or longer
+            const std::size_t from = sig.size();
+            for (const char ch : view) sig.push_back(char_classes[static_cast<unsigned char>(ch)]);
+            std::sort(sig.begin() + static_cast<std::ptrdiff_t>(from), sig.end());
+            sig.erase(std::unique(sig.begin() + static_cast<std::ptrdiff_t>(from), sig.end()), sig.end());
+        }
+        else
+        {
+            // Wide values are kept as is
+            sig.push_back(4);
+            for (const auto ch : value) sig.push_back(static_cast<std::size_t>(ch));
+        }
+    }
+
+    /**
+     * @brief Assign an id to each term value of the rule and collect the character tests of its terms and ranges. Multi-character terms are tested by their first character, like in the handle automaton
+     */
+    template<std::size_t N>
+    void add_value_tests(const std::array<RuleOp, N>& ops, std::vector<std::pair<char, char>>& char_tests)
+    {
+        for (const RuleOp& op : ops)
+        {
+            if (op.kind == RuleOpKind::Term)
+            {
+                term_values.try_emplace(op.name, term_values.size());
+                if (!op.name.empty()) char_tests.emplace_back(op.name[0], op.name[0]);
+            }
+            else if (op.kind == RuleOpKind::Range)
+                char_tests.emplace_back(op.start, op.end);
+        }
+    }
+
+    /**
+     * @brief Decisions are only memoized when they do not depend on the parsing history
+     */
+    static constexpr bool memoized()
+    {
+        return enabled<SRConfEnum::LazyAutomaton>() && !enabled<SRConfEnum::PrettyPrint>() &&
+               !enabled<SRConfEnum::ReducibilityChecker>() && !enabled<SRConfEnum::HeuristicCtx>();
+    }
+
+    static constexpr bool handles_enabled() { return enabled<SRConfEnum::HandleAutomaton>() && !enabled<SRConfEnum::PrettyPrint>(); }
+
+    /**
+     * @brief The handle automaton is also scanned by the LazyAutomaton, which keys its states by the stack suffix which may be reduced
+     */
+    static constexpr bool scans_handles() { return handles_enabled() || memoized(); }
+
+    static constexpr bool shift_only_enabled() { return enabled<SRConfEnum::ShiftOnly>() && !enabled<SRConfEnum::PrettyPrint>(); }
+
+    /**
+     * @brief Length of the longest rule, windows which are longer are never matched. Unbounded if some rule contains a repeat
+     */
+    static constexpr std::size_t max_rule_len()
+    {
+        return []<class... Defs>(const std::tuple<Defs...>*){
+            return std::max({std::size_t(0), RuleProgram<std::decay_t<get_second_t<Defs>>, RulesSymbol>::bounds.max_len...});
+        }(static_cast<const typename RulesSymbol::term_types_tuple*>(nullptr));
     }
 
     /**
@@ -950,95 +1751,25 @@ protected:
         return false;
     }
 
+    /**
+     * @brief Check if the stack window starting at start matches the rule definition. The rule is matched by its compiled program
+     * @param symbol Rule definition
+     * @param index Number of matched symbols, advanced on success
+     * @param handle_index Callback which receives the reached index of each sequence
+     */
     template<class TSymbol>
-    constexpr bool descend_batch_runtime(const std::vector<GSymbolV>& stack, std::size_t start, const TSymbol& symbol, std::size_t& index, auto handle_index) const
+    bool match_rule(const Stack& stack, std::size_t start, const TSymbol& symbol, std::size_t& index, auto handle_index) const
     {
-        if (start + index >= stack.size()) return false;
-
-        if constexpr (is_operator<TSymbol>())
-        {
-            if constexpr (get_operator<TSymbol>() == OpType::Concat)
-            {
-                std::size_t index_stack = index;
-                bool ok = symbol.each_or_exit([&](const auto& s) -> bool {
-                    if (!descend_batch_runtime(stack, start, s, index_stack, handle_index))
-                        return false; // Didn't find anything
-                    return true; // Continue
-                });
-                if (ok) index = index_stack;
-                handle_index(index_stack, ok); // We need to handle case when index_stack is lost
-                return ok;
-            }
-            else if constexpr (get_operator<TSymbol>() == OpType::Alter)
-            {
-                // Get each element and check if at least one matches
-                return !symbol.each_or_exit([&](const auto& s) -> bool {
-                    if (descend_batch_runtime(stack, start, s, index, handle_index)) return false; // Found
-                    return true; // Continue
-                });
-            }
-            else if constexpr (get_operator<TSymbol>() == OpType::Optional)
-            {
-                // Try to match if we can, just return true anyway
-                return descend_batch_runtime(stack, start, std::get<0>(symbol.terms), index, handle_index);
-            }
-            else if constexpr (get_operator<TSymbol>() == OpType::Repeat)
-            {
-                while (descend_batch_runtime(stack, start, std::get<0>(symbol.terms), index, handle_index)) {}
-                return true;
-            }
-            else if constexpr (get_operator<TSymbol>() == OpType::Group)
-            {
-                return descend_batch_runtime(stack, start, std::get<0>(symbol.terms), index, handle_index);
-            }
-            else if constexpr (get_operator<TSymbol>() == OpType::Except)
-            {
-                std::size_t i = index;
-                if (descend_batch_runtime(stack, start, std::get<0>(symbol.terms), i, handle_index))
-                {
-                    // Check if the symbol is an exception
-                    if (!descend_batch_runtime(stack, start, std::get<1>(symbol.terms), i, handle_index))
-                    {
-                        index = i;
-                        return true;
-                    }
-                    handle_index(i, false); // Else we need to store the lost index
-                }
-                return false;
-            }
-            else
-            {
-                // TODO implement other operators
-            }
-        } else if constexpr (is_nterm<TSymbol>()) {
-            const GSymbolV& elem = stack[start + index];
-            if (!elem.is_token() && elem.type.front() == symbol.type())
-            {
-                index++;
-                return true;
-            }
-            return false;
-
-        } else if constexpr (terminal_type<TSymbol>()) {
-            const GSymbolV& elem = stack[start + index];
-            if constexpr (is_term<TSymbol>())
-            {
-                if (elem.is_token() && elem.value == symbol.name)
-                {
-                    index++;
-                    return true;
-                }
-            } else { // Range
-                if (elem.is_token() && in_terms_range<TSymbol>(elem.value[0])) // TODO cover case when value is > 1 symbol
-                {
-                    index++;
-                    return true;
-                }
-            }
-            return false;
+        using Program = RuleProgram<std::decay_t<TSymbol>, RulesSymbol>;
+        return run_rule_op(Program::ops.data(), 0, stack, start, index, handle_index, [this](const GSymbolRef& sym){ return is_run_token(sym); });
+    }
 
-        } else static_assert(terminal_type<TSymbol>() || is_nterm<TSymbol>() || is_operator<TSymbol>(), "Wrong symbol type");
-        return false;
+    /**
+     * @brief Check if the multi-character token is a run of characters coalesced by the lexer (see LexerConfEnum::CoalesceRuns), as opposed to a terminal
+     */
+    bool is_run_token(const GSymbolRef& sym) const
+    {
+        return sym.type.size() == 1 && std::find(run_nterms.begin(), run_nterms.end(), sym.type[0]) != run_nterms.end();
     }
 
     template<SRConfEnum Value>
@@ -1049,6 +1780,10 @@ protected:
 template<class VStr, class TokenType, class Tree, class RulesSymbol, class TLexer, class Conf>
 constexpr auto make_sr_parser(const RulesSymbol& rules, const TLexer& lex, Conf conf, auto& printer)
 {
+    if constexpr (is_symbol_id_v<TokenType>)
+        static_assert(std::is_same_v<typename TokenType::rules_type, std::remove_cvref_t<RulesSymbol>>, "SymbolId was built for a different grammar");
+    static_assert(!conf.template flag<SRConfEnum::Lookahead2>() || conf.template flag<SRConfEnum::Lookahead>(), "Lookahead2 requires Lookahead");
+
     // Initialize reverse rules tree
     auto rr_tree = reverse_rules_tree_factory(rules); //ReverseRuleTreeFactory().build(root);
 
@@ -1081,7 +1816,7 @@ constexpr auto make_sr_parser(const RulesSymbol& rules, const TLexer& lex, Conf
     auto instantiate_lookahead = [&](){
         if constexpr (conf.template flag<SRConfEnum::Lookahead>())
         {
-            auto look = simple_lookahead_factory(rr_tree, defs);
+            auto look = simple_lookahead_factory<conf.template flag<SRConfEnum::Lookahead2>() ? 2 : 1>(rr_tree, defs);
             if constexpr (conf.template flag<SRConfEnum::PrettyPrint>())
             {
                 /*std::cout << "  REVERSE RULES TREE : " << std::endl;
@@ -6,6 +6,8 @@
 #define SUPERCFG_PREPROCESS_H
 
 #include <vector>
+#include <array>
+#include <limits>
 #include <cstdint>
 #include <cassert>
 #include <unordered_map>
@@ -13,10 +15,16 @@
 #include <typeindex>
 #include <variant>
 #include <utility>
+#include <type_traits>
+#include <istream>
+#include <string_view>
+#include <algorithm>
+#include <thread>
 
 #include "cfg/base.h"
 #include "cfg/helpers.h"
 #include "cfg/hashtable.h"
+#include "cfg/byte_class.h"
 
 
 /**
@@ -199,6 +207,162 @@ public:
 };
 
 
+/**
+ * @brief POD parser stack entry. Tokens reference the tokens array, nonterminals reference the nterm types table of the parser
+ */
+struct CompactSymbol
+{
+    std::size_t index; // Token position or nterm types id
+    bool token;
+
+    static constexpr CompactSymbol make_token(std::size_t i) { return CompactSymbol{i, true}; }
+
+    static constexpr CompactSymbol make_nterm(std::size_t id) { return CompactSymbol{id, false}; }
+
+    constexpr bool operator==(const CompactSymbol& rhs) const = default;
+};
+
+static_assert(std::is_trivially_copyable_v<CompactSymbol> && sizeof(CompactSymbol) <= 16, "CompactSymbol should be a small POD");
+
+
+/**
+ * @brief Non-owning view of a stack entry with the GrammarSymbol interface
+ */
+template<class VStr, class Type>
+class GrammarSymbolRef
+{
+public:
+    const VStr& value;
+    const Type& type;
+    bool token;
+
+    constexpr GrammarSymbolRef(const VStr& value, const Type& type, bool token) : value(value), type(type), token(token) {}
+
+    constexpr auto visit(auto process_token, auto process_nterm) const
+    {
+        if (token) return process_token();
+        return process_nterm();
+    }
+
+    [[nodiscard]] constexpr bool is_token() const { return token; }
+
+    void with_types(const auto& symbols_ht, auto func) const
+    {
+        if (is_token())
+        {
+            // Return either a Term or a Range
+            symbols_ht.get_term(value, func);
+        } else {
+            symbols_ht.get_nterm(type.front(), func);
+        }
+    }
+};
+
+
+/**
+ * @brief Parser stack of CompactSymbol entries. Values and types are looked up on access, so the stack may be copied with memcpy
+ * @tparam VStr Token string container
+ * @tparam Type Types set container
+ */
+template<class VStr, class Type>
+class SymbolStack
+{
+public:
+    using TokenV = Token<VStr, Type>;
+    using GSymbolRef = GrammarSymbolRef<VStr, Type>;
+
+protected:
+    std::vector<CompactSymbol> entries;
+    const TokenV* tokens;
+    const Type* nterm_types;
+
+public:
+    SymbolStack(const std::vector<TokenV>& tokens, const std::vector<Type>& nterm_types) : entries(), tokens(tokens.data()), nterm_types(nterm_types.data()) {}
+
+    // Unbound stack, should be reset before use
+    SymbolStack() : entries(), tokens(nullptr), nterm_types(nullptr) {}
+
+    /**
+     * @brief Clear the stack and bind it to the new input, the entries capacity is kept
+     */
+    void reset(const std::vector<TokenV>& t, const std::vector<Type>& types)
+    {
+        entries.clear();
+        tokens = t.data();
+        nterm_types = types.data();
+    }
+
+    /**
+     * @brief Copy the first n entries of the stack
+     */
+    [[nodiscard]] SymbolStack prefix(std::size_t n) const
+    {
+        SymbolStack res(*this, 0);
+        res.entries.assign(entries.begin(), entries.begin() + n);
+        return res;
+    }
+
+    [[nodiscard]] std::size_t size() const { return entries.size(); }
+
+    [[nodiscard]] bool empty() const { return entries.empty(); }
+
+    [[nodiscard]] GSymbolRef resolve(const CompactSymbol& s) const
+    {
+        if (s.token)
+            return GSymbolRef(tokens[s.index].value, tokens[s.index].type, true);
+        return GSymbolRef(empty_value(), nterm_types[s.index], false);
+    }
+
+    GSymbolRef operator[](std::size_t i) const { return resolve(entries[i]); }
+
+    GSymbolRef back() const { return resolve(entries.back()); }
+
+    [[nodiscard]] const CompactSymbol& entry(std::size_t i) const { return entries[i]; }
+
+    void push_back(const CompactSymbol& s) { entries.push_back(s); }
+
+    /**
+     * @brief Drop all entries starting from position n
+     */
+    void truncate(std::size_t n) { entries.resize(n); }
+
+    /**
+     * @brief Point the stack to the new tokens storage, should be called after the tokens vector is reallocated
+     */
+    void rebind(const std::vector<TokenV>& t) { tokens = t.data(); }
+
+    /**
+     * @brief Read-only view of the stack entries from the start position to the top, symbols are resolved on access
+     */
+    class Window
+    {
+    protected:
+        const SymbolStack* stack;
+        std::size_t start;
+
+    public:
+        Window(const SymbolStack* s, std::size_t start) : stack(s), start(start) {}
+
+        [[nodiscard]] std::size_t size() const { return stack->size() - start; }
+
+        GSymbolRef operator[](std::size_t i) const { return stack->resolve(stack->entries[start + i]); }
+
+        [[nodiscard]] const CompactSymbol& entry(std::size_t i) const { return stack->entries[start + i]; }
+    };
+
+    [[nodiscard]] Window window(std::size_t start) const { return Window(this, start); }
+
+protected:
+    SymbolStack(const SymbolStack& rhs, int) : entries(), tokens(rhs.tokens), nterm_types(rhs.nterm_types) {}
+
+    static const VStr& empty_value()
+    {
+        static const VStr value{};
+        return value;
+    }
+};
+
+
 /**
  * @brief Container of tokens (terminals), handles the mapping between string and its related type
  * @tparam VStr Token string container
@@ -352,7 +516,7 @@ protected:
     void do_populate_ht()
     {
         const auto& symbol = std::get<i>(terms);
-        const auto value = TypeSet<TokenType>(tuple_morph([]<std::size_t k>(const auto& src){ return VStr(std::get<k>(src).type()); }, std::get<i>(nterms)));
+        const auto value = TypeSet<TokenType>(tuple_morph([]<std::size_t k>(const auto& src){ return TokenType(std::get<k>(src).type()); }, std::get<i>(nterms)));
 
         if constexpr (is_term<decltype(symbol)>())
         {
@@ -373,7 +537,7 @@ protected:
         const auto& symbol = std::get<i>(terms);
 
         // Morph tuple into runtime TypeSet
-        const auto value = TypeSet<TokenType>(tuple_morph([]<std::size_t k>(const auto& src){ return VStr(std::get<k>(src).type()); }, std::get<i>(nterms)));
+        const auto value = TypeSet<TokenType>(tuple_morph([]<std::size_t k>(const auto& src){ return TokenType(std::get<k>(src).type()); }, std::get<i>(nterms)));
 
         if constexpr (is_term<decltype(symbol)>())
         {
@@ -533,6 +697,113 @@ protected:
 };
 
 
+/**
+ * @brief Lex the reader input through a fixed-size buffer. The unconsumed tail of each chunk (a partially matched terminal) is carried over to the next chunk
+ * @param reader Callback (TChar* dst, std::size_t n) -> number of the read characters, 0 at the end of input, negative on a read error
+ * @param buffer_size Buffer length, which limits the length of a single token
+ * @param scan Callback (text, last) -> number of the consumed characters
+ */
+template<class TChar, class Reader, class Scan>
+bool lex_chunks(Reader&& reader, std::size_t buffer_size, Scan&& scan)
+{
+    std::vector<TChar> buffer(std::max<std::size_t>(buffer_size, 1));
+    std::size_t filled = 0;
+    bool last = false;
+    while (!last)
+    {
+        if (filled == buffer.size()) return false; // The token does not fit into the buffer
+
+        const auto res = reader(buffer.data() + filled, buffer.size() - filled);
+        if constexpr (std::is_signed_v<decltype(res)>)
+        {
+            if (res < 0) return false; // Truncated input
+        }
+        const auto n = static_cast<std::size_t>(res);
+        last = (n == 0);
+        filled += n;
+
+        const std::size_t pos = scan(std::basic_string_view<TChar>(buffer.data(), filled), last);
+        std::move(buffer.begin() + static_cast<std::ptrdiff_t>(pos), buffer.begin() + static_cast<std::ptrdiff_t>(filled), buffer.begin());
+        filled -= pos;
+    }
+    return filled == 0;
+}
+
+
+/**
+ * @brief Create the reader over an input stream for the streaming lexer. A stream in the bad state is reported as a read error
+ */
+template<class TChar>
+auto make_istream_reader(std::basic_istream<TChar>& in)
+{
+    return [&in](TChar* dst, std::size_t n) -> std::ptrdiff_t {
+        in.read(dst, static_cast<std::streamsize>(n));
+        if (in.bad()) return -1;
+        return static_cast<std::ptrdiff_t>(in.gcount());
+    };
+}
+
+
+/**
+ * @brief Lex the text in parallel chunks. Each worker lexes its chunk speculatively, assuming that a token starts at the chunk start.
+ * Chunks are joined in order : the next chunk is kept from its token which starts at the end of the previous one, otherwise it is lexed again from there
+ * @param scan Callback (start, limit, emit) -> end of the last token, which starts in [start, limit). emit receives each token and its end
+ * @param n_workers Maximum number of threads
+ * @param min_chunk Minimum chunk length
+ */
+template<class TToken, class Scan>
+std::vector<TToken> lex_parallel(std::size_t size, bool& ok, std::size_t n_workers, std::size_t min_chunk, Scan&& scan)
+{
+    struct Chunk
+    {
+        std::vector<TToken> tokens;
+        std::vector<std::size_t> starts; // Start of each token
+        std::size_t end;
+    };
+
+    const std::size_t n = std::max<std::size_t>(1, std::min(n_workers, size / std::max<std::size_t>(min_chunk, 1)));
+    std::vector<std::size_t> bounds(n + 1);
+    for (std::size_t k = 0; k <= n; k++) bounds[k] = size * k / n;
+
+    std::vector<Chunk> chunks(n);
+    auto work = [&](std::size_t k){
+        Chunk& c = chunks[k];
+        std::size_t prev = bounds[k];
+        c.end = scan(bounds[k], bounds[k + 1], [&](TToken&& tok, std::size_t end){
+            c.tokens.push_back(std::move(tok));
+            c.starts.push_back(prev);
+            prev = end;
+        });
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t k = 1; k < n; k++)
+        threads.emplace_back(work, k);
+    work(0);
+    for (auto& t : threads) t.join();
+
+    // The first chunk starts at a real token boundary
+    std::vector<TToken> tokens = std::move(chunks[0].tokens);
+    std::size_t pos = chunks[0].end;
+    for (std::size_t k = 1; k < n && pos >= bounds[k]; k++)
+    {
+        const Chunk& c = chunks[k];
+        const auto it = std::lower_bound(c.starts.begin(), c.starts.end(), pos);
+        if (it != c.starts.end() && *it == pos)
+        {
+            // Synchronized, the rest of the chunk is valid
+            const auto j = it - c.starts.begin();
+            tokens.insert(tokens.end(), std::make_move_iterator(c.tokens.begin() + j), std::make_move_iterator(c.tokens.end()));
+            pos = c.end;
+        }
+        else pos = scan(pos, bounds[k + 1], [&](TToken&& tok, std::size_t){ tokens.push_back(std::move(tok)); }); // Wrong guess
+    }
+
+    ok = (pos == size);
+    return tokens;
+}
+
+
 /**
  * @brief Single-pass tokenizer class. Does not support multiple tokens of the same type
  * @tparam VStr Variable string class
@@ -558,8 +829,50 @@ public:
     std::vector<Token<VStr, TypeSingleton<TokenType>>> run(const VText& text, bool& ok) const
     {
         std::vector<Token<VStr, TypeSingleton<TokenType>>> tokens;
-        std::size_t pos = 0;
-        for (std::size_t i = 0; i < text.size(); i++)
+        const std::size_t pos = scan(text, 0, text.size(), true, [&](Token<VStr, TypeSingleton<TokenType>>&& tok, std::size_t){ tokens.push_back(std::move(tok)); });
+
+//        assert(pos == text.size() && "Tokenization error: found unrecognized tokens");
+        ok = (pos == text.size());
+        return tokens;
+    }
+
+    /**
+     * @brief Lex the text in parallel chunks, the result is the same as in run()
+     * @param n_workers Maximum number of threads
+     * @param min_chunk Minimum chunk length
+     */
+    template<class VText>
+    std::vector<Token<VStr, TypeSingleton<TokenType>>> run_parallel(const VText& text, bool& ok, std::size_t n_workers = std::thread::hardware_concurrency(), std::size_t min_chunk = 1 << 16) const
+    {
+        return lex_parallel<Token<VStr, TypeSingleton<TokenType>>>(text.size(), ok, n_workers, min_chunk, [&](std::size_t start, std::size_t limit, auto&& emit){
+            return scan(text, start, limit, true, emit);
+        });
+    }
+
+    /**
+     * @brief Lex the input of unknown length through a fixed-size buffer, tokens are passed to the sink as they are found
+     * @param reader Callback (TChar* dst, std::size_t n) -> number of the read characters, 0 at the end of input, negative on a read error
+     * @param sink Callback which receives each token
+     */
+    template<class Reader, class Sink>
+    bool run_stream(Reader&& reader, Sink&& sink, std::size_t buffer_size = 1 << 16) const
+    {
+        return lex_chunks<typename VStr::value_type>(reader, buffer_size, [&](const auto& text, bool last){
+            return scan(text, 0, text.size(), last, [&](auto&& tok, std::size_t){ sink(std::move(tok)); });
+        });
+    }
+
+    void prettyprint() const { } // Nothing to print
+
+protected:
+    /**
+     * @brief Emit the tokens which start in [start, limit) along with their ends, returns the end of the last token
+     */
+    template<class VText, class Emit>
+    std::size_t scan(const VText& text, std::size_t start, std::size_t limit, bool, Emit&& emit) const
+    {
+        std::size_t pos = start;
+        for (std::size_t i = start; i < text.size() && pos < limit; i++)
         {
             VStr tok = VStr::from_slice(text, pos, i + 1);
             const auto it = ht.find(tok);
@@ -567,21 +880,15 @@ public:
             if (it != ht.end())
             {
                 // Terminal found
-                std::size_t n = tokens.size();
                 // We shouldn't actually merge tokens
                 // if (n > 0 && tokens[n - 1].type == it->second) tokens[n - 1].value += it->first;
                 // else tokens.push_back(Token<VStr, TokenType>(it->first, it->second));
-                tokens.push_back(Token<VStr, TypeSingleton<TokenType>>(it->first, TypeSingleton<TokenType>(it->second)));
+                emit(Token<VStr, TypeSingleton<TokenType>>(it->first, TypeSingleton<TokenType>(it->second)), i + 1);
                 pos = i + 1;
             }
         }
-
-//        assert(pos == text.size() && "Tokenization error: found unrecognized tokens");
-        ok = (pos == text.size());
-        return tokens;
+        return pos;
     }
-
-    void prettyprint() const { } // Nothing to print
 };
 
 
@@ -600,29 +907,16 @@ public:
     [[nodiscard]] static constexpr bool is_legacy() { return false; }
     const auto& all_terms() const { return terms_map.terms; }
 
-    constexpr explicit Lexer(const TermsTMap& terms) : terms_map(terms) {}
+    /**
+     * @param run_nterms Nterms defined as a Repeat over single characters. Runs of their characters are emitted as one token
+     */
+    explicit Lexer(const TermsTMap& terms, const std::vector<TokenType>& run_nterms = {}) : terms_map(terms), coalesce(run_nterms) { init_runs(false); }
 
     template<class VText>
     std::vector<Token<VStr, TypeSet<TokenType>>> run(const VText& text, bool& ok) const
     {
         std::vector<Token<VStr, TypeSet<TokenType>>> tokens;
-        std::size_t pos = 0;
-        for (std::size_t i = 0; i < text.size(); i++)
-        {
-            VStr tok = VStr::from_slice(text, pos, i + 1);
-            const auto it = terms_map.get_it(tok);
-
-            if (it != terms_map.end())
-            {
-                // Terminal found
-                // std::size_t n = tokens.size();
-                // We shouldn't actually merge tokens
-                // if (n > 0 && tokens[n - 1].type == it->second) tokens[n - 1].value += it->first;
-                // else tokens.push_back(Token<VStr, TokenType>(it->first, it->second));
-                tokens.push_back(Token<VStr, TypeSet<TokenType>>(it->first, it->second));
-                pos = i + 1;
-            }
-        }
+        const std::size_t pos = scan(text, 0, text.size(), true, [&](Token<VStr, TypeSet<TokenType>>&& tok, std::size_t){ tokens.push_back(std::move(tok)); });
 
         //        assert(pos == text.size() && "Tokenization error: found unrecognized tokens");
         ok = (pos == text.size());
@@ -630,6 +924,32 @@ public:
         return tokens;
     }
 
+    /**
+     * @brief Lex the text in parallel chunks, the result is the same as in run()
+     * @param n_workers Maximum number of threads
+     * @param min_chunk Minimum chunk length
+     */
+    template<class VText>
+    std::vector<Token<VStr, TypeSet<TokenType>>> run_parallel(const VText& text, bool& ok, std::size_t n_workers = std::thread::hardware_concurrency(), std::size_t min_chunk = 1 << 16) const
+    {
+        return lex_parallel<Token<VStr, TypeSet<TokenType>>>(text.size(), ok, n_workers, min_chunk, [&](std::size_t start, std::size_t limit, auto&& emit){
+            return scan(text, start, limit, true, emit);
+        });
+    }
+
+    /**
+     * @brief Lex the input of unknown length through a fixed-size buffer, tokens are passed to the sink as they are found
+     * @param reader Callback (TChar* dst, std::size_t n) -> number of the read characters, 0 at the end of input, negative on a read error
+     * @param sink Callback which receives each token
+     */
+    template<class Reader, class Sink>
+    bool run_stream(Reader&& reader, Sink&& sink, std::size_t buffer_size = 1 << 16) const
+    {
+        return lex_chunks<typename VStr::value_type>(reader, buffer_size, [&](const auto& text, bool last){
+            return scan(text, 0, text.size(), last, [&](auto&& tok, std::size_t){ sink(std::move(tok)); });
+        });
+    }
+
     void print_tokens(const std::vector<Token<VStr, TypeSet<TokenType>>>& tokens) const
     {
         for (const auto& tok : tokens)
@@ -639,6 +959,117 @@ public:
 
     void prettyprint() const { do_print<0>(); }
 protected:
+    ByteClasses<TypeSet<TokenType>> runs; // Single-character terminals, grouped by their types
+    std::vector<TokenType> coalesce; // Nterms which absorb a whole run
+    std::array<bool, 256> merge{}; // Classes which are emitted as one token per run
+
+    /**
+     * @brief Collect the single-character terminals into byte classes
+     * @param exclusive Skip the characters which start longer terminals, as they are not emitted alone under the maximal munch
+     */
+    void init_runs(bool exclusive)
+    {
+        runs = ByteClasses<TypeSet<TokenType>>();
+        if constexpr (sizeof(typename VStr::value_type) == 1)
+        {
+            std::array<bool, 256> prefix{};
+            for (const auto& [str, types] : terms_map.storage)
+                if (exclusive && str.size() > 1) prefix[static_cast<unsigned char>(str[0])] = true;
+
+            for (const auto& [str, types] : terms_map.storage)
+            {
+                const auto b = static_cast<unsigned char>(str.size() == 1 ? str[0] : 0);
+                if (str.size() != 1 || prefix[b]) continue;
+                runs.add(b, types, [](const TypeSet<TokenType>& lhs, const TypeSet<TokenType>& rhs){
+                    if (lhs.size() != rhs.size()) return false;
+                    for (std::size_t k = 0; k < lhs.size(); k++)
+                        if (!(lhs[k] == rhs[k])) return false;
+                    return true;
+                });
+            }
+            runs.build();
+
+            // Merge the runs which may only be absorbed by a single Repeat
+            merge.fill(false);
+            for (std::size_t cls = 1; cls <= runs.size(); cls++)
+            {
+                const auto& types = runs.value(static_cast<std::uint8_t>(cls));
+                merge[cls] = types.size() == 1 && std::find(coalesce.begin(), coalesce.end(), types[0]) != coalesce.end();
+            }
+        }
+    }
+
+    /**
+     * @brief Emit the run of single-character terminals at pos, returns the run length. Separate characters are emitted before limit.
+     * A merged run is one token, which may extend past the limit as the other terminals do
+     * @param last Whether the text ends the input. Otherwise a merged run which reaches the text end is left unconsumed and partial is set
+     */
+    template<class VText, class Emit>
+    std::size_t scan_run(const VText& text, std::size_t pos, std::size_t limit, bool last, Emit&& emit, bool& partial) const
+    {
+        partial = false;
+        if constexpr (sizeof(typename VStr::value_type) == 1)
+        {
+            const std::uint8_t cls = runs[static_cast<unsigned char>(text[pos])];
+            if (cls == runs.none) return 0;
+            const auto* bytes = reinterpret_cast<const unsigned char*>(text.data()) + pos;
+            if (merge[cls])
+            {
+                const std::size_t n = runs.run(bytes, text.size() - pos, cls);
+                if (pos + n == text.size() && !last)
+                {
+                    partial = true; // The run may continue in the next chunk
+                    return 0;
+                }
+                emit(Token<VStr, TypeSet<TokenType>>(VStr::from_slice(text, pos, pos + n), runs.value(cls)), pos + n);
+                return n;
+            }
+            const std::size_t n = runs.run(bytes, limit - pos, cls);
+            for (std::size_t i = pos; i < pos + n; i++)
+                emit(Token<VStr, TypeSet<TokenType>>(VStr::from_slice(text, i, i + 1), runs.value(cls)), i + 1);
+            return n;
+        } else return 0;
+    }
+
+    /**
+     * @brief Emit the tokens which start in [start, limit) along with their ends, returns the end of the last token. Token values are taken from the terms map
+     */
+    template<class VText, class Emit>
+    std::size_t scan(const VText& text, std::size_t start, std::size_t limit, bool last, Emit&& emit) const
+    {
+        std::size_t pos = start;
+        for (std::size_t i = start; i < text.size() && pos < limit; i++)
+        {
+            if (i == pos && !runs.empty())
+            {
+                // Runs of single-character terminals skip the hashtable
+                bool partial;
+                const std::size_t n = scan_run(text, pos, limit, last, emit, partial);
+                if (partial) break;
+                if (n > 0)
+                {
+                    pos += n;
+                    i = pos - 1;
+                    continue;
+                }
+            }
+
+            VStr tok = VStr::from_slice(text, pos, i + 1);
+            const auto it = terms_map.get_it(tok);
+
+            if (it != terms_map.end())
+            {
+                // Terminal found
+                // We shouldn't actually merge tokens
+                // if (n > 0 && tokens[n - 1].type == it->second) tokens[n - 1].value += it->first;
+                // else tokens.push_back(Token<VStr, TokenType>(it->first, it->second));
+                emit(Token<VStr, TypeSet<TokenType>>(it->first, it->second), i + 1);
+                pos = i + 1;
+            }
+        }
+        return pos;
+    }
+
     template<std::size_t depth>
     void do_print() const
     {
@@ -657,6 +1088,168 @@ protected:
 };
 
 
+/**
+ * @brief Single-pass tokenizer which walks a trie over all terminals instead of building a string for each prefix. The trie is stored as a flat transitions table over the compressed input alphabet
+ * @tparam VStr Variable string class. If it's a StrView, token values reference the input text without copying
+ * @tparam TokenType Nonterminal type (name) container
+ * @tparam do_maximal_munch Emit the longest matching terminal instead of the first (shortest) one
+ */
+template<class VStr, class TokenType, class TermsTMap, bool do_maximal_munch>
+class DFALexer : public Lexer<VStr, TokenType, TermsTMap>
+{
+protected:
+    using TChar = typename VStr::value_type;
+    using state_t = std::uint32_t;
+    static_assert(sizeof(TChar) == 1, "DFA lexer only supports single-byte characters");
+
+    static constexpr state_t dead = std::numeric_limits<state_t>::max();
+    static constexpr std::size_t no_accept = std::numeric_limits<std::size_t>::max();
+
+    std::array<std::uint8_t, 256> classes; // Character -> equivalence class. Class 0 is reserved for characters which are not present in any terminal
+    std::size_t n_classes;
+    std::vector<state_t> transitions; // [state * n_classes + class] -> next state
+    std::vector<std::size_t> accept; // state -> index of the accepted token
+    std::vector<TypeSet<TokenType>> accepted; // Types of the accepted tokens
+
+public:
+    explicit DFALexer(const TermsTMap& terms, const std::vector<TokenType>& run_nterms = {}) : Lexer<VStr, TokenType, TermsTMap>(terms, run_nterms), classes(), n_classes(1)
+    {
+        classes.fill(0);
+        // Alphabet compression: only the characters which occur in terminals get their own class
+        for (const auto& [str, types] : this->terms_map.storage)
+        {
+            for (const TChar c : str)
+            {
+                if (classes[to_byte(c)] == 0)
+                    classes[to_byte(c)] = n_classes++;
+            }
+        }
+
+        // Root state
+        transitions.assign(n_classes, dead);
+        accept.push_back(no_accept);
+
+        for (const auto& [str, types] : this->terms_map.storage)
+        {
+            if (str.empty()) continue; // Empty terminals are never matched by the lexer
+            state_t s = 0;
+            for (const TChar c : str)
+            {
+                const std::size_t at = s * n_classes + classes[to_byte(c)];
+                if (transitions[at] == dead)
+                {
+                    // New trie node
+                    transitions[at] = accept.size();
+                    transitions.resize(transitions.size() + n_classes, dead);
+                    accept.push_back(no_accept);
+                }
+                s = transitions[at];
+            }
+            accept[s] = accepted.size();
+            accepted.push_back(types);
+        }
+        if constexpr (do_maximal_munch) this->init_runs(true);
+    }
+
+    template<class VText>
+    std::vector<Token<VStr, TypeSet<TokenType>>> run(const VText& text, bool& ok) const
+    {
+        std::vector<Token<VStr, TypeSet<TokenType>>> tokens;
+        const std::size_t pos = scan(text, 0, text.size(), true, [&](Token<VStr, TypeSet<TokenType>>&& tok, std::size_t){ tokens.push_back(std::move(tok)); });
+
+        ok = (pos == text.size());
+        return tokens;
+    }
+
+    /**
+     * @brief Lex the text in parallel chunks, the result is the same as in run()
+     * @param n_workers Maximum number of threads
+     * @param min_chunk Minimum chunk length
+     */
+    template<class VText>
+    std::vector<Token<VStr, TypeSet<TokenType>>> run_parallel(const VText& text, bool& ok, std::size_t n_workers = std::thread::hardware_concurrency(), std::size_t min_chunk = 1 << 16) const
+    {
+        return lex_parallel<Token<VStr, TypeSet<TokenType>>>(text.size(), ok, n_workers, min_chunk, [&](std::size_t start, std::size_t limit, auto&& emit){
+            return scan(text, start, limit, true, emit);
+        });
+    }
+
+    /**
+     * @brief Lex the input of unknown length through a fixed-size buffer, tokens are passed to the sink as they are found.
+     * Token values are copied out of the buffer, so VStr should own its data
+     * @param reader Callback (TChar* dst, std::size_t n) -> number of the read characters, 0 at the end of input, negative on a read error
+     * @param sink Callback which receives each token
+     */
+    template<class Reader, class Sink>
+    bool run_stream(Reader&& reader, Sink&& sink, std::size_t buffer_size = 1 << 16) const
+    {
+        static_assert(!std::is_base_of_v<std::basic_string_view<TChar>, VStr>, "DFALexer::run_stream() : token values cannot reference the reused buffer, use an owning string class");
+        return lex_chunks<TChar>(reader, buffer_size, [&](const auto& text, bool last){
+            return scan(text, 0, text.size(), last, [&](auto&& tok, std::size_t){ sink(std::move(tok)); });
+        });
+    }
+
+protected:
+    /**
+     * @brief Emit the tokens which start in [start, limit) along with their ends, returns the end of the last token
+     * @param last Whether the text ends the input. Otherwise a terminal which may continue after the text end is left unconsumed
+     */
+    template<class VText, class Emit>
+    std::size_t scan(const VText& text, std::size_t start, std::size_t limit, bool last, Emit&& emit) const
+    {
+        std::size_t pos = start;
+        while (pos < limit)
+        {
+            if (!this->runs.empty())
+            {
+                // Only a merged run may continue into the next chunk
+                bool partial;
+                const std::size_t n = this->scan_run(text, pos, limit, last, emit, partial);
+                if (partial) break;
+                if (n > 0)
+                {
+                    pos += n;
+                    continue;
+                }
+            }
+
+            state_t s = 0;
+            std::size_t match = no_accept, match_end = pos;
+            bool partial = true; // The scan reached the text end
+            for (std::size_t i = pos; i < text.size(); i++)
+            {
+                s = transitions[s * n_classes + classes[to_byte(text[i])]];
+                if (s == dead) // No terminal starts with this prefix
+                {
+                    partial = false;
+                    break;
+                }
+
+                if (accept[s] != no_accept)
+                {
+                    match = accept[s];
+                    match_end = i + 1;
+                    if constexpr (!do_maximal_munch)
+                    {
+                        partial = false;
+                        break; // Emit the first matching prefix, same as Lexer::run
+                    }
+                }
+            }
+
+            if (partial && !last) break; // The terminal may continue in the next chunk
+            if (match == no_accept) break; // Unrecognized token
+            // If VStr is a view, the token references the input text
+            emit(Token<VStr, TypeSet<TokenType>>(VStr::from_slice(text, pos, match_end), accepted[match]), match_end);
+            pos = match_end;
+        }
+        return pos;
+    }
+
+    static constexpr std::size_t to_byte(const TChar c) { return static_cast<unsigned char>(c); }
+};
+
+
 
 template<class TRulesDefOp>
 class NTermHTItem
@@ -730,14 +1323,10 @@ public:
     constexpr SymbolsHashTable(const Terms& terms, const NTerms& nterms) : terms_map(), nterms_map()
     {
         tuple_each(terms, [&](std::size_t i, const auto& term){
-            // Iterate over each element in lexical range
             if constexpr (is_terms_range<std::decay_t<decltype(term)>>())
             {
-                term.each_range([&](auto symbol){
-                    const auto t = TokenType(symbol);
-                    // if (!terms_map.contains(t))
-                    terms_map.insert(t, term); // We don't care what to insert
-                });
+                // Stored as a single interval
+                terms_map.insert_range(term.get_start(), term.get_end(), term);
             } else {
                 const auto t = TokenType(term.type());
                 terms_map.insert(t, term);
@@ -749,9 +1338,10 @@ public:
         });
     }
 
-    auto get_term(const TokenType& type, auto func) const
+    template<class TStr>
+    auto get_term(const TStr& type, auto func) const
     {
-        return terms_map.get(type, func);
+        return terms_map.get(type, func); // Views are looked up in place
     }
 
     auto get_nterm(const TokenType& type, auto func) const
@@ -1065,25 +1655,25 @@ class NoPrettyPrinter
 {
 public:
     template<class VStr, class TokenTSet, class TokenType>
-    void update_stack(const std::vector<GrammarSymbol<VStr, TokenTSet>>& stack, const std::vector<ConstVec<TokenType>>& related_types, const ConstVec<TokenType>& intersect, int idx)
+    void update_stack(const SymbolStack<VStr, TokenTSet>& stack, const std::vector<ConstVec<TokenType>>& related_types, const ConstVec<TokenType>& intersect, int idx)
     {
         // do nothing
     }
 
     template<class VStr, class TokenTSet, class TSymbol>
-    void update_descend(const std::vector<GrammarSymbol<VStr, TokenTSet>>& stack, const TSymbol& rule, std::size_t idx, std::size_t candidate, std::size_t total, std::size_t parsed, bool found) {}
+    void update_descend(const SymbolStack<VStr, TokenTSet>& stack, const TSymbol& rule, std::size_t idx, std::size_t candidate, std::size_t total, std::size_t parsed, bool found) {}
 
     template<class Tree>
     void update_ast(const Tree& tree) {}
 
-    template<std::size_t N, class TMatches, class TFix, class CTODO, class GSymbol>
-    void update_heur_ctx_at_next(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& pre, const std::vector<TFix>& post, const CTODO prefix, const CTODO postfix, const std::vector<GSymbol>& stack) {}
+    template<std::size_t N, class TMatches, class TFix, class CTODO, class TStack>
+    void update_heur_ctx_at_next(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& pre, const std::vector<TFix>& post, const CTODO prefix, const CTODO postfix, const TStack& stack) {}
 
     template<class TSymbol>
     void update_heur_ctx_at_check(const TSymbol& match, bool accepted) {}
 
-    template<std::size_t N, class TMatches, class TFix, class CTODO, class GSymbol, class TSymbol>
-    void update_heur_ctx_at_apply(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& pre, const std::vector<TFix>& post, const CTODO prefix, const CTODO postfix, const std::vector<GSymbol>& stack, const TSymbol& match) {}
+    template<std::size_t N, class TMatches, class TFix, class CTODO, class TStack, class TSymbol>
+    void update_heur_ctx_at_apply(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& pre, const std::vector<TFix>& post, const CTODO prefix, const CTODO postfix, const TStack& stack, const TSymbol& match) {}
 
     void set_empty_descend() {}
 
@@ -7,6 +7,8 @@
 
 #include "cfg/helpers.h"
 #include "cfg/preprocess.h"
+#include "cfg/str.h"
+#include "cfg/symbol_id.h"
 #include "cfg/base.h"
 #include "cfg/helpers_runtime.h"
 
@@ -775,6 +777,23 @@ namespace cfg_helpers
             //return std::tuple<>();
         else return std::tuple<>();
     }
+
+    /**
+     * @brief Check if the symbol only matches a single character : a TermsRange, a one-character Term, or an Alter/Group of them
+     */
+    template<class TSymbol>
+    constexpr bool is_char_class()
+    {
+        if constexpr (is_operator<TSymbol>())
+        {
+            constexpr OpType op = get_operator<TSymbol>();
+            if constexpr (op == OpType::Alter || op == OpType::Group)
+                return []<class... Ts>(const std::tuple<Ts...>*){ return (is_char_class<Ts>() && ...); }(static_cast<const typename TSymbol::term_types_tuple*>(nullptr));
+            else return false;
+        }
+        else if constexpr (is_term<TSymbol>()) return std::decay_t<TSymbol>::_name_type::size() == 2; // Including \0
+        else return is_terms_range<TSymbol>();
+    }
 };
 
 
@@ -921,6 +940,9 @@ enum class LexerConfEnum : std::uint64_t
     AdvancedLexer = 0x1, /** Use advanced lexer with duplicate terms handling */
     HandleDuplicates = 0x10, /** Advanced handling of duplicate elements at compile-time. Required for term ranges support and duplicate terms which are present in >2 rules at once */
     HandleDupInRuntime = 0x100, /** Move advanced handling of duplicate element to runtime lexer initialization */
+    DFALexer = 0x1000, /** Use the advanced lexer which scans the input using a precompiled terminals trie */
+    MaximalMunch = 0x10000, /** Emit the longest matching terminal instead of the shortest one. Requires DFALexer */
+    CoalesceRuns = 0x100000, /** Emit a run of characters which only belong to a Repeat over single characters (N := {a-z}) as one token. Requires AdvancedLexer or DFALexer */
 };
 
 template<std::uint64_t Conf>
@@ -943,14 +965,49 @@ constexpr auto mk_lexer_conf()
 }
 
 
+/**
+ * @brief Get the nterms which are defined as a Repeat over single characters (N := {a-z}). Runs of their characters may be lexed as one token
+ */
+template<class TokenType, class RulesSymbol>
+std::vector<TokenType> repeat_run_nterms(const RulesSymbol& rules)
+{
+    std::vector<TokenType> res;
+    rules.each([&](const auto& def){
+        using Body = std::remove_cvref_t<decltype(std::get<1>(def.terms))>;
+        if constexpr (is_operator<Body>())
+        {
+            if constexpr (get_operator<Body>() == OpType::Repeat)
+            {
+                if constexpr (cfg_helpers::is_char_class<std::tuple_element_t<0, typename Body::term_types_tuple>>())
+                    res.push_back(TokenType(std::get<0>(def.terms).type()));
+            }
+        }
+    });
+    return res;
+}
+
+
 template<class VStr, class TokenType, class RulesSymbol, class Conf>
 constexpr auto make_lexer(const RulesSymbol& rules, Conf conf)
 {
-    if constexpr (conf.template flag<LexerConfEnum::AdvancedLexer>())
+    static_assert(!conf.template flag<LexerConfEnum::MaximalMunch>() || conf.template flag<LexerConfEnum::DFALexer>(), "MaximalMunch requires DFALexer");
+    static_assert(!is_str_view_v<VStr> || conf.template flag<LexerConfEnum::DFALexer>(), "Zero-copy token values require DFALexer");
+    static_assert(!conf.template flag<LexerConfEnum::CoalesceRuns>() || conf.template flag<LexerConfEnum::AdvancedLexer>() || conf.template flag<LexerConfEnum::DFALexer>(), "CoalesceRuns requires AdvancedLexer or DFALexer");
+    if constexpr (is_symbol_id_v<TokenType>)
+        static_assert(std::is_same_v<typename TokenType::rules_type, std::remove_cvref_t<RulesSymbol>>, "SymbolId was built for a different grammar");
+    if constexpr (conf.template flag<LexerConfEnum::AdvancedLexer>() || conf.template flag<LexerConfEnum::DFALexer>())
     {
         auto terms_cache = terms_tree_cache_factory(rules);
-        auto terms_type_map = terms_type_map_factory<VStr, TokenType, conf.template flag<LexerConfEnum::HandleDuplicates>(), conf.template flag<LexerConfEnum::HandleDupInRuntime>()>(terms_cache);
-        return Lexer<VStr, TokenType, std::decay_t<decltype(terms_type_map)>>(terms_type_map);
+        // Terms table always owns its strings
+        auto terms_type_map = terms_type_map_factory<str_owner_t<VStr>, TokenType, conf.template flag<LexerConfEnum::HandleDuplicates>(), conf.template flag<LexerConfEnum::HandleDupInRuntime>()>(terms_cache);
+        std::vector<TokenType> run_nterms;
+        if constexpr (conf.template flag<LexerConfEnum::CoalesceRuns>())
+            run_nterms = repeat_run_nterms<TokenType>(rules);
+
+        if constexpr (conf.template flag<LexerConfEnum::DFALexer>())
+            return DFALexer<VStr, TokenType, std::decay_t<decltype(terms_type_map)>, conf.template flag<LexerConfEnum::MaximalMunch>()>(terms_type_map, run_nterms);
+        else
+            return Lexer<VStr, TokenType, std::decay_t<decltype(terms_type_map)>>(terms_type_map, run_nterms);
     } else {
         return LexerLegacy<VStr, TokenType>(rules);
     }
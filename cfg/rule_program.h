@@ -0,0 +1,533 @@
+#ifndef SUPERCFG_RULE_PROGRAM_H
+#define SUPERCFG_RULE_PROGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include "cfg/base.h"
+#include "cfg/containers.h"
+#include "cfg/preprocess.h"
+#include "cfg/symbol_id.h"
+
+
+enum class RuleOpKind : std::uint8_t
+{
+    Concat,
+    Alter,
+    Optional,
+    Repeat,
+    Group,
+    Except,
+    RepeatN, // RepeatExact, RepeatGE and RepeatRange
+    Term,
+    Range,
+    NTerm,
+    Fail // Comment and SpecialSeq, which never match
+};
+
+
+/**
+ * @brief Single instruction of a flattened rule. Children of an operator follow it, each child subtree ends at the child's next position
+ */
+struct RuleOp
+{
+    RuleOpKind kind = RuleOpKind::Fail;
+    std::uint32_t next = 0; // Position after the subtree of this instruction
+    std::size_t from = 0; // Minimum number of repeats, or the nterm id
+    std::size_t to = 0; // Maximum number of repeats
+    char start = 0, end = 0; // Terms range
+    std::string_view name; // Term value
+};
+
+
+namespace cfg_helpers
+{
+    template<class TSymbol>
+    constexpr std::size_t rule_children_count()
+    {
+        constexpr OpType op = get_operator<TSymbol>();
+        if constexpr (op == OpType::Concat || op == OpType::Alter)
+            return std::tuple_size_v<typename TSymbol::term_types_tuple>;
+        else if constexpr (op == OpType::Except)
+            return 2;
+        else if constexpr (op == OpType::Optional || op == OpType::Repeat || op == OpType::Group ||
+                           op == OpType::RepeatExact || op == OpType::RepeatGE || op == OpType::RepeatRange)
+            return 1;
+        else return 0;
+    }
+
+    /**
+     * @brief Number of instructions in the flattened rule
+     */
+    template<class TSymbol>
+    constexpr std::size_t rule_ops_count()
+    {
+        if constexpr (is_operator<TSymbol>())
+        {
+            return []<std::size_t... I>(std::index_sequence<I...>){
+                return (std::size_t(1) + ... + rule_ops_count<std::tuple_element_t<I, typename TSymbol::term_types_tuple>>());
+            }(std::make_index_sequence<rule_children_count<TSymbol>()>{});
+        }
+        else return 1;
+    }
+
+    /**
+     * @brief Id of a defined nterm. Defined nterms are numbered in the definition order, duplicates share the first id
+     */
+    template<class NT, class RulesSymbol>
+    constexpr std::size_t defined_nterm_id()
+    {
+        constexpr auto names = []<class... Defs>(const std::tuple<Defs...>*){
+            return std::array<std::string_view, sizeof...(Defs)>{ symbol_name<typename get_first<Defs>::type>()... };
+        }(static_cast<const typename std::remove_cvref_t<RulesSymbol>::term_types_tuple*>(nullptr));
+
+        const std::string_view name = symbol_name<NT>();
+        std::size_t id = 0;
+        for (std::size_t i = 0; i < names.size(); i++)
+        {
+            bool dup = false;
+            for (std::size_t j = 0; j < i; j++)
+                if (names[j] == names[i]) dup = true;
+            if (dup) continue;
+            if (names[i] == name) return id;
+            id++;
+        }
+        return std::numeric_limits<std::size_t>::max();
+    }
+
+    /**
+     * @brief Write the instructions of the symbol subtree at pos, returns the position after the subtree
+     */
+    template<class TSymbol, class RulesSymbol, std::size_t N>
+    constexpr std::size_t emit_rule_ops(std::array<RuleOp, N>& ops, std::size_t pos)
+    {
+        RuleOp op;
+        std::size_t next = pos + 1;
+
+        if constexpr (is_operator<TSymbol>())
+        {
+            constexpr OpType type = get_operator<TSymbol>();
+            if constexpr (type == OpType::Concat) op.kind = RuleOpKind::Concat;
+            else if constexpr (type == OpType::Alter) op.kind = RuleOpKind::Alter;
+            else if constexpr (type == OpType::Optional) op.kind = RuleOpKind::Optional;
+            else if constexpr (type == OpType::Repeat) op.kind = RuleOpKind::Repeat;
+            else if constexpr (type == OpType::Group) op.kind = RuleOpKind::Group;
+            else if constexpr (type == OpType::Except) op.kind = RuleOpKind::Except;
+            else if constexpr (type == OpType::RepeatExact || type == OpType::RepeatGE || type == OpType::RepeatRange)
+            {
+                op.kind = RuleOpKind::RepeatN;
+                if constexpr (type == OpType::RepeatExact)
+                    op.from = op.to = get_repeat_times<TSymbol>();
+                else if constexpr (type == OpType::RepeatGE)
+                {
+                    op.from = get_repeat_times<TSymbol>();
+                    op.to = std::numeric_limits<std::size_t>::max();
+                } else {
+                    op.from = get_range_from<TSymbol>();
+                    op.to = get_range_to<TSymbol>();
+                }
+            }
+
+            [&]<std::size_t... I>(std::index_sequence<I...>){
+                ((next = emit_rule_ops<std::tuple_element_t<I, typename TSymbol::term_types_tuple>, RulesSymbol>(ops, next)), ...);
+            }(std::make_index_sequence<rule_children_count<TSymbol>()>{});
+        }
+        else if constexpr (is_term<TSymbol>())
+        {
+            op.kind = RuleOpKind::Term;
+            op.name = symbol_name<TSymbol>();
+        }
+        else if constexpr (is_terms_range<TSymbol>())
+        {
+            op.kind = RuleOpKind::Range;
+            op.start = TSymbol::get_start();
+            op.end = TSymbol::get_end();
+        }
+        else if constexpr (is_nterm<TSymbol>())
+        {
+            op.kind = RuleOpKind::NTerm;
+            op.from = defined_nterm_id<TSymbol, RulesSymbol>();
+        }
+
+        op.next = static_cast<std::uint32_t>(next);
+        ops[pos] = op;
+        return next;
+    }
+}
+
+
+/**
+ * @brief Static bounds of a rule match : the number of matched symbols and the symbols which may open or close the window
+ * @tparam N Bits number : [0, 256) are the first characters of tokens, [256, N) are nterm ids
+ */
+template<std::size_t N>
+struct RuleBounds
+{
+    static constexpr std::size_t unbounded = std::numeric_limits<std::size_t>::max();
+
+    std::size_t min_len = 0, max_len = unbounded;
+    TypeBitset<N> first, last;
+    bool any_first = false, any_last = false; // The edge could not be computed, e.g. for unsupported operators
+};
+
+
+namespace cfg_helpers
+{
+    constexpr std::size_t bounded_add(std::size_t a, std::size_t b)
+    {
+        constexpr std::size_t inf = std::numeric_limits<std::size_t>::max();
+        return (a == inf || b == inf || a > inf - b) ? inf : a + b;
+    }
+
+    constexpr std::size_t bounded_mul(std::size_t a, std::size_t b)
+    {
+        constexpr std::size_t inf = std::numeric_limits<std::size_t>::max();
+        if (a == 0 || b == 0) return 0;
+        return (a == inf || b == inf || a > inf / b) ? inf : a * b;
+    }
+
+    /**
+     * @brief Minimum and maximum number of stack symbols matched by the instruction at pc
+     */
+    constexpr void rule_op_len(const RuleOp* ops, std::size_t pc, std::size_t& lo, std::size_t& hi)
+    {
+        constexpr std::size_t inf = std::numeric_limits<std::size_t>::max();
+        const RuleOp& op = ops[pc];
+        std::size_t c_lo = 0, c_hi = 0;
+        switch (op.kind)
+        {
+            case RuleOpKind::Concat:
+                lo = hi = 0;
+                for (std::size_t child = pc + 1; child < op.next; child = ops[child].next)
+                {
+                    rule_op_len(ops, child, c_lo, c_hi);
+                    lo = bounded_add(lo, c_lo);
+                    hi = bounded_add(hi, c_hi);
+                }
+                return;
+            case RuleOpKind::Alter:
+                lo = inf;
+                hi = 0;
+                for (std::size_t child = pc + 1; child < op.next; child = ops[child].next)
+                {
+                    rule_op_len(ops, child, c_lo, c_hi);
+                    lo = std::min(lo, c_lo);
+                    hi = std::max(hi, c_hi);
+                }
+                if (lo == inf) lo = 0;
+                return;
+            case RuleOpKind::Optional:
+                rule_op_len(ops, pc + 1, c_lo, hi);
+                lo = 0;
+                return;
+            case RuleOpKind::Group:
+            case RuleOpKind::Except:
+                rule_op_len(ops, pc + 1, lo, hi);
+                return;
+            case RuleOpKind::Repeat:
+                lo = 0;
+                hi = inf;
+                return;
+            case RuleOpKind::RepeatN:
+                rule_op_len(ops, pc + 1, c_lo, c_hi);
+                lo = bounded_mul(c_lo, op.from);
+                hi = bounded_mul(c_hi, op.to);
+                return;
+            case RuleOpKind::Term:
+            case RuleOpKind::Range:
+            case RuleOpKind::NTerm:
+                lo = hi = 1;
+                return;
+            default:
+                lo = 0;
+                hi = inf;
+                return;
+        }
+    }
+
+    template<std::size_t N>
+    constexpr bool rule_op_edge(const RuleOp* ops, std::size_t pc, bool reverse, TypeBitset<N>& bits, bool& any);
+
+    /**
+     * @brief Collect the edge symbols of the sequence [child, end). Children are only linked forwards, so the reverse order is taken on the way back
+     */
+    template<std::size_t N>
+    constexpr bool rule_seq_edge(const RuleOp* ops, std::size_t child, std::size_t end, bool reverse, TypeBitset<N>& bits, bool& any)
+    {
+        if (child >= end) return true;
+        if (!reverse)
+            return rule_op_edge(ops, child, reverse, bits, any) && rule_seq_edge(ops, ops[child].next, end, reverse, bits, any);
+        return rule_seq_edge(ops, ops[child].next, end, reverse, bits, any) && rule_op_edge(ops, child, reverse, bits, any);
+    }
+
+    /**
+     * @brief Collect the symbols which may be matched first (or last if reverse) by the instruction at pc, returns whether it may match nothing
+     */
+    template<std::size_t N>
+    constexpr bool rule_op_edge(const RuleOp* ops, std::size_t pc, bool reverse, TypeBitset<N>& bits, bool& any)
+    {
+        const RuleOp& op = ops[pc];
+        switch (op.kind)
+        {
+            case RuleOpKind::Concat:
+                return rule_seq_edge(ops, pc + 1, op.next, reverse, bits, any);
+            case RuleOpKind::Alter:
+            {
+                bool nullable = false;
+                for (std::size_t child = pc + 1; child < op.next; child = ops[child].next)
+                    nullable = rule_op_edge(ops, child, reverse, bits, any) || nullable;
+                return nullable;
+            }
+            case RuleOpKind::Optional:
+            case RuleOpKind::Repeat:
+                rule_op_edge(ops, pc + 1, reverse, bits, any);
+                return true;
+            case RuleOpKind::RepeatN:
+                return rule_op_edge(ops, pc + 1, reverse, bits, any) || op.from == 0;
+            case RuleOpKind::Group:
+            case RuleOpKind::Except:
+                return rule_op_edge(ops, pc + 1, reverse, bits, any);
+            case RuleOpKind::Term:
+                if (op.name.empty()) any = true;
+                else bits.set(static_cast<unsigned char>(op.name[0])); // Tokens are compared by their first character
+                return false;
+            case RuleOpKind::Range:
+                for (std::size_t c = static_cast<unsigned char>(op.start); c <= static_cast<unsigned char>(op.end); c++) bits.set(c);
+                return false;
+            case RuleOpKind::NTerm:
+                if (256 + op.from < N) bits.set(256 + op.from);
+                else any = true;
+                return false;
+            default:
+                any = true;
+                return false;
+        }
+    }
+
+    template<std::size_t N, std::size_t M>
+    constexpr RuleBounds<N> make_rule_bounds(const std::array<RuleOp, M>& ops)
+    {
+        RuleBounds<N> res;
+        rule_op_len(ops.data(), 0, res.min_len, res.max_len);
+        rule_op_edge(ops.data(), 0, false, res.first, res.any_first);
+        rule_op_edge(ops.data(), 0, true, res.last, res.any_last);
+        return res;
+    }
+}
+
+
+/**
+ * @brief Rule definition lowered into a flat array of instructions at compile time
+ * @tparam TSymbol Rule definition (right-hand side)
+ * @tparam RulesSymbol Grammar root, used to resolve the nterm ids
+ */
+template<class TSymbol, class RulesSymbol>
+struct RuleProgram
+{
+    static constexpr std::size_t size = cfg_helpers::rule_ops_count<TSymbol>();
+
+    static constexpr std::array<RuleOp, size> ops = []{
+        std::array<RuleOp, size> res{};
+        cfg_helpers::emit_rule_ops<TSymbol, RulesSymbol>(res, 0);
+        return res;
+    }();
+
+    // One bit per character and per defined nterm
+    static constexpr std::size_t n_bits = 256 + std::tuple_size_v<typename std::remove_cvref_t<RulesSymbol>::term_types_tuple>;
+
+    static constexpr RuleBounds<n_bits> bounds = cfg_helpers::make_rule_bounds<n_bits>(ops);
+};
+
+
+/**
+ * @brief Check the window [start, top] against the static bounds of a rule in O(1). False means that the rule cannot match the window
+ */
+template<std::size_t N, class VStr, class Type>
+bool rule_bounds_admit(const RuleBounds<N>& bounds, const SymbolStack<VStr, Type>& stack, std::size_t start)
+{
+    const std::size_t len = stack.size() - start;
+    if (len < bounds.min_len || len > bounds.max_len) return false;
+
+    auto admits = [&](const TypeBitset<N>& bits, const CompactSymbol& elem){
+        if (!elem.token) return 256 + elem.index < N && bits.test(256 + elem.index);
+        const VStr& value = stack.resolve(elem).value;
+        return value.empty() || bits.test(static_cast<unsigned char>(value[0]));
+    };
+    return (bounds.any_first || admits(bounds.first, stack.entry(start))) &&
+           (bounds.any_last || admits(bounds.last, stack.entry(stack.size() - 1)));
+}
+
+
+/**
+ * @brief Check if the instruction at pc matches a single character : a terms range, a one-character term, or an alternative/group of them
+ */
+inline bool rule_op_accepts_char(const RuleOp* ops, std::size_t pc, const char ch)
+{
+    const RuleOp& op = ops[pc];
+    switch (op.kind)
+    {
+        case RuleOpKind::Alter:
+        {
+            for (std::size_t child = pc + 1; child < op.next; child = ops[child].next)
+                if (rule_op_accepts_char(ops, child, ch)) return true;
+            return false;
+        }
+        case RuleOpKind::Group:
+            return rule_op_accepts_char(ops, pc + 1, ch);
+        case RuleOpKind::Term:
+            return op.name.size() == 1 && op.name[0] == ch;
+        case RuleOpKind::Range:
+            return in_lexical_range<char>(ch, op.start, op.end);
+        default:
+            return false;
+    }
+}
+
+
+/**
+ * @brief Match a coalesced run token (see LexerConfEnum::CoalesceRuns) against the body of a repeat : each of its characters should match the body
+ * @param is_run Callback which checks if the token is a coalesced run. Other multi-character tokens are terminals and are not split
+ */
+template<class VStr, class Type, class IsRun>
+bool run_rule_run(const RuleOp* ops, std::size_t pc, const SymbolStack<VStr, Type>& stack, std::size_t start, std::size_t& index, const IsRun& is_run)
+{
+    if (start + index >= stack.size()) return false;
+    const CompactSymbol& elem = stack.entry(start + index);
+    if (!elem.token) return false;
+    const auto sym = stack.resolve(elem);
+    const VStr& value = sym.value;
+    if (value.size() < 2 || !is_run(sym)) return false; // Single characters take the regular path
+    for (const auto ch : value)
+        if (!rule_op_accepts_char(ops, pc, ch)) return false;
+    index++;
+    return true;
+}
+
+
+/**
+ * @brief Greedily match the instruction at pc against the stack window [start + index, top]. Alternatives and repeats do not backtrack
+ * @param ops Rule instructions
+ * @param pc Instruction position
+ * @param stack Parser stack
+ * @param start Window start
+ * @param index Number of matched symbols in the window, advanced on success
+ * @param handle_index Callback which receives the reached index of each sequence, including the failed ones
+ * @param is_run Callback which checks if a multi-character token is a coalesced run, see run_rule_run()
+ */
+template<class VStr, class Type, class HandleIndex, class IsRun>
+bool run_rule_op(const RuleOp* ops, std::size_t pc, const SymbolStack<VStr, Type>& stack, std::size_t start, std::size_t& index, const HandleIndex& handle_index, const IsRun& is_run)
+{
+    if (start + index >= stack.size()) return false;
+
+    const RuleOp& op = ops[pc];
+    switch (op.kind)
+    {
+        case RuleOpKind::Concat:
+        {
+            std::size_t index_stack = index;
+            bool ok = true;
+            for (std::size_t child = pc + 1; child < op.next; child = ops[child].next)
+            {
+                if (!run_rule_op(ops, child, stack, start, index_stack, handle_index, is_run))
+                {
+                    ok = false; // Didn't find anything
+                    break;
+                }
+            }
+            if (ok) index = index_stack;
+            handle_index(index_stack, ok); // We need to handle case when index_stack is lost
+            return ok;
+        }
+        case RuleOpKind::Alter:
+        {
+            // Check if at least one element matches
+            for (std::size_t child = pc + 1; child < op.next; child = ops[child].next)
+                if (run_rule_op(ops, child, stack, start, index, handle_index, is_run)) return true;
+            return false;
+        }
+        case RuleOpKind::Optional:
+        case RuleOpKind::Group:
+            return run_rule_op(ops, pc + 1, stack, start, index, handle_index, is_run);
+        case RuleOpKind::Repeat:
+        {
+            while (run_rule_run(ops, pc + 1, stack, start, index, is_run) || run_rule_op(ops, pc + 1, stack, start, index, handle_index, is_run)) {}
+            return true;
+        }
+        case RuleOpKind::RepeatN:
+        {
+            std::size_t index_stack = index;
+            for (std::size_t i = 0; i < op.from; i++)
+            {
+                if (!run_rule_op(ops, pc + 1, stack, start, index_stack, handle_index, is_run))
+                    return false;
+            }
+            for (std::size_t i = op.from; i < op.to; i++)
+            {
+                if (!run_rule_op(ops, pc + 1, stack, start, index_stack, handle_index, is_run))
+                    break;
+            }
+            index = index_stack;
+            return true;
+        }
+        case RuleOpKind::Except:
+        {
+            std::size_t i = index;
+            if (run_rule_op(ops, pc + 1, stack, start, i, handle_index, is_run))
+            {
+                // Check if the symbol is an exception
+                if (!run_rule_op(ops, ops[pc + 1].next, stack, start, i, handle_index, is_run))
+                {
+                    index = i;
+                    return true;
+                }
+                handle_index(i, false); // Else we need to store the lost index
+            }
+            return false;
+        }
+        case RuleOpKind::Term:
+        {
+            const CompactSymbol& elem = stack.entry(start + index);
+            if (!elem.token) return false;
+            const VStr& value = stack.resolve(elem).value;
+            if (value.size() == op.name.size() && std::equal(op.name.begin(), op.name.end(), value.begin()))
+            {
+                index++;
+                return true;
+            }
+            return false;
+        }
+        case RuleOpKind::Range:
+        {
+            const CompactSymbol& elem = stack.entry(start + index);
+            if (!elem.token) return false;
+            const VStr& value = stack.resolve(elem).value;
+            if (value.size() == 1 && in_lexical_range<char>(value[0], op.start, op.end)) // Runs of range characters are matched by run_rule_run
+            {
+                index++;
+                return true;
+            }
+            return false;
+        }
+        case RuleOpKind::NTerm:
+        {
+            const CompactSymbol& elem = stack.entry(start + index);
+            if (!elem.token && elem.index == op.from)
+            {
+                index++;
+                return true;
+            }
+            return false;
+        }
+        case RuleOpKind::Fail:
+            return false; // Comments and special sequences describe no input
+    }
+    return false;
+}
+
+
+#endif //SUPERCFG_RULE_PROGRAM_H
@@ -6,6 +6,7 @@
 #define SUPERCFG_STR_H
 
 #include <string>
+#include <string_view>
 
 #include "cfg/base.h"
 
@@ -35,6 +36,8 @@ public:
     template<ConstStrContainer STR>
     constexpr explicit StdStr(const ConstStr<STR>& c) : std::basic_string<TChar>(c.c_str(), ConstStr<STR>::size()-1) {} // Excluding \0
 
+    constexpr explicit StdStr(const std::basic_string_view<TChar>& v) : std::basic_string<TChar>(v) {}
+
     /**
      * @brief Construct a new StdStr from a slice of a string
      * @param src String to slice
@@ -46,6 +49,14 @@ public:
         return StdStr<TChar>(src.c_str() + start, end - start);
     }
 
+    /**
+     * @brief Copy a slice of a non-owning text, e.g. a memory-mapped file
+     */
+    static StdStr<TChar> from_slice(const std::basic_string_view<TChar> src, std::size_t start, std::size_t end)
+    {
+        return StdStr<TChar>(src.data() + start, end - start);
+    }
+
     /**
      * @brief Check if one string starts with another (abc, abcdef returns true)
      */
@@ -77,6 +88,78 @@ template<class TChar, ConstStrContainer STR>
 bool operator==(const ConstStr<STR>& lhs, const StdStr<TChar>& rhs) { return rhs == lhs; }
 
 
+/**
+ * @brief Non-owning string class which references a slice of another string. Used for zero-copy token values, the source text must outlive all views
+ */
+template<class TChar>
+class StrView : public std::basic_string_view<TChar>
+{
+public:
+    constexpr StrView() : std::basic_string_view<TChar>() {}
+
+    constexpr StrView(const StrView<TChar>& rhs) = default;
+
+    constexpr StrView(const std::basic_string_view<TChar>& rhs) : std::basic_string_view<TChar>(rhs) {}
+
+    constexpr explicit StrView(const TChar* ch, std::size_t N) : std::basic_string_view<TChar>(ch, N) {}
+
+    constexpr explicit StrView(const std::basic_string<TChar>& s) : std::basic_string_view<TChar>(s) {}
+
+    // ConstStr contents have static storage duration
+    template<ConstStrContainer STR>
+    constexpr explicit StrView(const ConstStr<STR>& c) : std::basic_string_view<TChar>(c.c_str(), ConstStr<STR>::size()-1) {} // Excluding \0
+
+    StrView<TChar>& operator=(const StrView<TChar>& rhs) = default;
+
+    /**
+     * @brief Reference a slice of a string without copying it
+     * @param src String to slice
+     * @param start Starting index of range
+     * @param end The index of the string end (character after the last symbol in range)
+     */
+    static constexpr StrView<TChar> from_slice(const std::basic_string_view<TChar> src, std::size_t start, std::size_t end)
+    {
+        return StrView<TChar>(src.data() + start, end - start);
+    }
+};
+
+
+template<class TChar>
+struct std::hash<StrView<TChar>>
+{
+    std::size_t operator()(const StrView<TChar>& s) const noexcept
+    {
+        return std::hash<std::basic_string_view<TChar>>{}(s);
+    }
+};
+
+
+template<class TChar, ConstStrContainer STR>
+constexpr bool operator==(const StrView<TChar>& lhs, const ConstStr<STR>& rhs)
+{
+    return lhs.compare(0, lhs.size(), rhs.c_str(), ConstStr<STR>::size() - 1) == 0;
+}
+
+template<class TChar, ConstStrContainer STR>
+constexpr bool operator==(const ConstStr<STR>& lhs, const StrView<TChar>& rhs) { return rhs == lhs; }
+
+
+/**
+ * @brief Get the string class which owns its contents. Lexer tables cannot store views
+ */
+template<class VStr>
+struct str_owner { using type = VStr; };
+
+template<class TChar>
+struct str_owner<StrView<TChar>> { using type = StdStr<TChar>; };
+
+template<class VStr>
+using str_owner_t = typename str_owner<VStr>::type;
+
+template<class VStr>
+constexpr bool is_str_view_v = !std::is_same_v<str_owner_t<VStr>, VStr>;
+
+
 
 /*template<class Char, std::size_t BYTES, std::size_t CHUNK, std::size_t GROWTH>
 class VarStr
@@ -0,0 +1,192 @@
+#ifndef SUPERCFG_SYMBOL_ID_H
+#define SUPERCFG_SYMBOL_ID_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+
+#include "cfg/base.h"
+#include "cfg/containers.h"
+
+
+namespace cfg_helpers
+{
+    /**
+     * @brief Static storage for single characters of terms ranges
+     */
+    inline constexpr std::array<char, 256> single_chars = []{
+        std::array<char, 256> chars{};
+        for (std::size_t i = 0; i < chars.size(); i++) chars[i] = static_cast<char>(i);
+        return chars;
+    }();
+
+    /**
+     * @brief Upper bound of the symbol names number in a grammar tree, including duplicates
+     */
+    template<class TSymbol>
+    constexpr std::size_t symbol_names_count()
+    {
+        if constexpr (!requires { typename TSymbol::_is_operator; })
+            return 0; // Raw strings in comments and special sequences
+        else if constexpr (is_operator<TSymbol>())
+            return []<class... Ts>(const std::tuple<Ts...>*){ return (std::size_t(0) + ... + symbol_names_count<Ts>()); }(static_cast<const typename TSymbol::term_types_tuple*>(nullptr));
+        else if constexpr (is_terms_range<TSymbol>())
+            return static_cast<unsigned char>(TSymbol::get_end()) - static_cast<unsigned char>(TSymbol::get_start()) + 1;
+        else
+            return 1;
+    }
+
+    template<class TSymbol>
+    constexpr std::string_view symbol_name()
+    {
+        using CStr = typename TSymbol::_name_type;
+        return std::string_view(CStr().c_str(), CStr::size() - 1); // Excluding \0
+    }
+
+    template<std::size_t N>
+    constexpr void add_symbol_name(std::array<std::string_view, N>& names, std::size_t& n, const std::string_view name)
+    {
+        for (std::size_t i = 0; i < n; i++)
+            if (names[i] == name) return;
+        names[n++] = name;
+    }
+
+    template<class TSymbol, std::size_t N>
+    constexpr void collect_symbol_names(std::array<std::string_view, N>& names, std::size_t& n)
+    {
+        if constexpr (!requires { typename TSymbol::_is_operator; })
+            return;
+        else if constexpr (is_operator<TSymbol>())
+            [&]<class... Ts>(const std::tuple<Ts...>*){ (collect_symbol_names<Ts>(names, n), ...); }(static_cast<const typename TSymbol::term_types_tuple*>(nullptr));
+        else if constexpr (is_terms_range<TSymbol>())
+        {
+            // Each character of the range is a separate symbol
+            for (std::size_t c = static_cast<unsigned char>(TSymbol::get_start()); c <= static_cast<unsigned char>(TSymbol::get_end()); c++)
+                add_symbol_name(names, n, std::string_view(&single_chars[c], 1));
+        }
+        else
+            add_symbol_name(names, n, symbol_name<TSymbol>());
+    }
+
+    template<std::size_t N>
+    struct SymbolNames
+    {
+        std::array<std::string_view, N> names;
+        std::size_t size;
+        std::size_t nterms;
+    };
+
+    /**
+     * @brief Assign a dense index to each unique symbol name in the grammar. Defined nonterminals come first
+     */
+    template<class RulesSymbol>
+    constexpr auto make_symbol_names()
+    {
+        SymbolNames<symbol_names_count<RulesSymbol>()> res{{}, 0, 0};
+        [&]<class... Defs>(const std::tuple<Defs...>*){ (add_symbol_name(res.names, res.size, symbol_name<typename get_first<Defs>::type>()), ...); }(static_cast<const typename RulesSymbol::term_types_tuple*>(nullptr));
+        res.nterms = res.size;
+        collect_symbol_names<RulesSymbol>(res.names, res.size);
+        return res;
+    }
+}
+
+
+/**
+ * @brief Dense integer symbol type which may be used as TokenType instead of a string. Each NTerm, Term and range character in the grammar is assigned an id at compile time, names are resolved only for printing
+ * @tparam RulesSymbol Grammar root (RulesDef) type
+ * @tparam TId Underlying integer type
+ */
+template<class RulesSymbol, class TId = std::uint16_t>
+class SymbolId
+{
+protected:
+    static constexpr auto table = cfg_helpers::make_symbol_names<std::remove_cvref_t<RulesSymbol>>();
+    static_assert(table.size < std::numeric_limits<TId>::max(), "Too many symbols for this id type");
+
+public:
+    using id_type = TId;
+    using rules_type = std::remove_cvref_t<RulesSymbol>;
+    static constexpr TId npos = std::numeric_limits<TId>::max();
+
+    TId id;
+
+    constexpr SymbolId() : id(npos) {}
+
+    constexpr explicit SymbolId(const TId i, std::in_place_t) : id(i) {}
+
+    // Resolved at compile time
+    template<ConstStrContainer STR>
+    constexpr explicit SymbolId(const ConstStr<STR>& c) : id(id_of<STR>())
+    {
+        static_assert(id_of<STR>() != npos, "Symbol is not present in the grammar");
+    }
+
+    // Resolved in runtime, only used during initialization and for token values lookup
+    explicit SymbolId(const std::string_view name) : id(find(name)) {}
+
+    explicit SymbolId(const char c) : id(find(std::string_view(&cfg_helpers::single_chars[static_cast<unsigned char>(c)], 1))) {}
+
+    [[nodiscard]] static constexpr std::size_t size() { return table.size; }
+
+    [[nodiscard]] static constexpr std::size_t nterms_size() { return table.nterms; }
+
+    [[nodiscard]] constexpr std::string_view name() const { return id == npos ? std::string_view() : table.names[id]; }
+
+    constexpr operator std::string_view() const { return name(); }
+
+    constexpr bool operator==(const SymbolId& rhs) const { return id == rhs.id; }
+
+    template<ConstStrContainer STR>
+    constexpr bool operator==(const ConstStr<STR>& rhs) const { return id == id_of<STR>(); }
+
+    friend std::ostream& operator<<(std::ostream& os, const SymbolId& s) { return os << s.name(); }
+
+    template<ConstStrContainer STR>
+    static constexpr TId id_of()
+    {
+        constexpr TId i = find_static(std::string_view(STR.c_str(), STR.size() - 1));
+        return i;
+    }
+
+protected:
+    static constexpr TId find_static(const std::string_view name)
+    {
+        for (std::size_t i = 0; i < table.size; i++)
+            if (table.names[i] == name) return static_cast<TId>(i);
+        return npos;
+    }
+
+    static TId find(const std::string_view name)
+    {
+        static const std::unordered_map<std::string_view, TId> lookup = []{
+            std::unordered_map<std::string_view, TId> ht;
+            for (std::size_t i = 0; i < table.size; i++) ht.insert({table.names[i], static_cast<TId>(i)});
+            return ht;
+        }();
+        const auto it = lookup.find(name);
+        return it != lookup.end() ? it->second : npos;
+    }
+};
+
+
+template<class RulesSymbol, class TId>
+struct std::hash<SymbolId<RulesSymbol, TId>>
+{
+    std::size_t operator()(const SymbolId<RulesSymbol, TId>& s) const noexcept { return s.id; }
+};
+
+
+template<class T>
+struct is_symbol_id : std::false_type {};
+
+template<class RulesSymbol, class TId>
+struct is_symbol_id<SymbolId<RulesSymbol, TId>> : std::true_type {};
+
+template<class T>
+constexpr bool is_symbol_id_v = is_symbol_id<std::remove_cvref_t<T>>::value;
+
+
+#endif //SUPERCFG_SYMBOL_ID_H
@@ -372,13 +372,13 @@ public:
 
     // Stack rendering
     template<class VStr, class TokenTSet, class TokenType>
-    void update_stack(const std::vector<GrammarSymbol<VStr, TokenTSet>>& stack, const std::vector<ConstVec<TokenType>>& related_types, const ConstVec<TokenType>& intersect, std::size_t idx)
+    void update_stack(const SymbolStack<VStr, TokenTSet>& stack, const std::vector<ConstVec<TokenType>>& related_types, const ConstVec<TokenType>& intersect, std::size_t idx)
     {
         update_widget(make_stack(stack, related_types, intersect, idx), PrinterWindows::Stack);
     }
 
     template<class VStr, class TokenTSet, class TSymbol>
-    void update_descend(const std::vector<GrammarSymbol<VStr, TokenTSet>>& stack, const TSymbol& rule, std::size_t idx, std::size_t candidate, std::size_t total, std::size_t parsed, bool found)
+    void update_descend(const SymbolStack<VStr, TokenTSet>& stack, const TSymbol& rule, std::size_t idx, std::size_t candidate, std::size_t total, std::size_t parsed, bool found)
     {
         update_widget(make_descend(stack, rule, idx, candidate, total, parsed, found), PrinterWindows::Descend);
     }
@@ -398,8 +398,8 @@ public:
     }
 
     // Process heuristic ctx during next()
-    template<std::size_t N, class TMatches, class TFix, class CTODO, class GSymbol>
-    void update_heur_ctx_at_next(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& prefix, const std::vector<TFix>& postfix, const CTODO prefix_todo, const CTODO postfix_todo, const std::vector<GSymbol>& stack)
+    template<std::size_t N, class TMatches, class TFix, class CTODO, class TStack>
+    void update_heur_ctx_at_next(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& prefix, const std::vector<TFix>& postfix, const CTODO prefix_todo, const CTODO postfix_todo, const TStack& stack)
     {
         update_widget(make_context_at_next(context, nterms, prefix, postfix, prefix_todo, postfix_todo, stack), PrinterWindows::HeurCtx);
     }
@@ -418,8 +418,8 @@ public:
     }
 
     // Process heuristic ctx during apply_reduce()
-    template<std::size_t N, class TMatches, class TFix, class CTODO, class GSymbol, class TSymbol>
-    void update_heur_ctx_at_apply(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& prefix, const std::vector<TFix>& postfix, const CTODO prefix_todo, const CTODO postfix_todo, const std::vector<GSymbol>& stack, const TSymbol& match)
+    template<std::size_t N, class TMatches, class TFix, class CTODO, class TStack, class TSymbol>
+    void update_heur_ctx_at_apply(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& prefix, const std::vector<TFix>& postfix, const CTODO prefix_todo, const CTODO postfix_todo, const TStack& stack, const TSymbol& match)
     {
         update_widget(make_context_at_apply(context, nterms, prefix, postfix, prefix_todo, postfix_todo, stack, match), PrinterWindows::HeurCtx);
     }
@@ -499,8 +499,8 @@ protected:
         }
     }
 
-    template<class VStr, class TokenTSet>
-    static Widget<TChar> make_token(const GrammarSymbol<VStr, TokenTSet>& s)
+    template<class GSymbol>
+    static Widget<TChar> make_token(const GSymbol& s)
     {
         if (s.is_token())
             return Widget<TChar>(std::basic_string<TChar>('\"' + std::basic_string<TChar>(s.value)) + '\"', Colors::Accent2);
@@ -902,7 +902,7 @@ protected:
     }
 
     template<class VStr, class TokenTSet, class TokenType>
-    Widget<TChar> make_stack(const std::vector<GrammarSymbol<VStr, TokenTSet>>& stack, const std::vector<ConstVec<TokenType>>& related_types, const ConstVec<TokenType>& intersect, std::size_t idx)
+    Widget<TChar> make_stack(const SymbolStack<VStr, TokenTSet>& stack, const std::vector<ConstVec<TokenType>>& related_types, const ConstVec<TokenType>& intersect, std::size_t idx)
     {
         Widget<TChar> stack_box(WidgetLayout::Horizontal, {
             Widget<TChar>(WidgetLayout::Vertical, {
@@ -1017,7 +1017,7 @@ protected:
     }
 
     template<class VStr, class TokenTSet, class TSymbol>
-    Widget<TChar> make_descend(const std::vector<GrammarSymbol<VStr, TokenTSet>>& stack, const TSymbol& rule, std::size_t idx, std::size_t candidate, std::size_t total, std::size_t parsed, bool found)
+    Widget<TChar> make_descend(const SymbolStack<VStr, TokenTSet>& stack, const TSymbol& rule, std::size_t idx, std::size_t candidate, std::size_t total, std::size_t parsed, bool found)
     {
         Widget<TChar> rr_grid(WidgetLayout::Horizontal, { // we have to populate the first row with a spacer for the status row
             Widget<TChar>(WidgetLayout::Vertical, { Widget<TChar>(), make_nterm(std::get<0>(rule)) }, Colors::None)
@@ -1129,8 +1129,8 @@ protected:
     }
 
 
-    template<std::size_t N, class TMatches, class TFix, class CTODO, class GSymbol>
-    Widget<TChar> make_context(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& prefix, const std::vector<TFix>& postfix, const CTODO pre_todo, const CTODO post_todo, const std::vector<GSymbol>& stack)
+    template<std::size_t N, class TMatches, class TFix, class CTODO, class TStack>
+    Widget<TChar> make_context(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& prefix, const std::vector<TFix>& postfix, const CTODO pre_todo, const CTODO post_todo, const TStack& stack)
     {
         std::size_t stack_size = stack.size();
 
@@ -1219,8 +1219,8 @@ protected:
     }
 
 
-    template<std::size_t N, class TMatches, class TFix, class CTODO, class GSymbol>
-    Widget<TChar> make_context_at_next(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& prefix, const std::vector<TFix>& postfix, const CTODO pre_todo, const CTODO post_todo, const std::vector<GSymbol>& stack)
+    template<std::size_t N, class TMatches, class TFix, class CTODO, class TStack>
+    Widget<TChar> make_context_at_next(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& prefix, const std::vector<TFix>& postfix, const CTODO pre_todo, const CTODO post_todo, const TStack& stack)
     {
         auto stack_box = make_context(context, nterms, prefix, postfix, pre_todo, post_todo, stack);
         // Render status
@@ -1247,8 +1247,8 @@ protected:
         old_widget.at(1).back().at(1).refresh(make_symbol(match));
     }
 
-    template<std::size_t N, class TMatches, class TFix, class CTODO, class GSymbol, class TSymbol>
-    Widget<TChar> make_context_at_apply(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& prefix, const std::vector<TFix>& postfix, const CTODO pre_todo, const CTODO post_todo, const std::vector<GSymbol>& stack, const TSymbol& match)
+    template<std::size_t N, class TMatches, class TFix, class CTODO, class TStack, class TSymbol>
+    Widget<TChar> make_context_at_apply(const std::array<std::size_t, N>& context, const TMatches& nterms, const std::vector<TFix>& prefix, const std::vector<TFix>& postfix, const CTODO pre_todo, const CTODO post_todo, const TStack& stack, const TSymbol& match)
     {
         auto stack_box = make_context(context, nterms, prefix, postfix, pre_todo, post_todo, stack);
         // Render status
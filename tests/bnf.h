@@ -5,17 +5,124 @@
 #ifndef SUPERCFG_BNF_H
 #define SUPERCFG_BNF_H
 
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 #include "cfg/gbnf.h"
 #include "cfg/containers.h"
 #include "cfg/base.h"
 #include "cfg/parser.h"
+#include "cfg/lr_parser.h"
+#include "cfg/batch.h"
+#include "cfg/mmap.h"
 #include "cfg/str.h"
 #include "cfg/preprocess_factories.h"
 #include "extra/ast_serializer.h"
 
 
+/**
+ * @brief Nested groups and arrays of lowercase strings, e.g. (abc,[a,(b,c)]). op is the root symbol
+ */
+constexpr auto nested_lists_grammar()
+{
+    constexpr auto ch = NTerm(cs<"char">());
+    constexpr auto d_ch = Define(ch, Repeat(TermsRange(cs<"a">(), cs<"z">())));
+
+    constexpr auto str = NTerm(cs<"string">());
+    constexpr auto d_str = Define(str, Repeat(ch));
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto group = NTerm(cs<"group">());
+    constexpr auto array = NTerm(cs<"array">());
+
+    constexpr auto d_group = Define(group, Concat(Term(cs<"(">()), op, Repeat(Concat(Term(cs<",">()), op)), Term(cs<")">())));
+    constexpr auto d_array = Define(array, Concat(Term(cs<"[">()), op, Repeat(Concat(Term(cs<",">()), op)), Term(cs<"]">())));
+    constexpr auto d_op = Define(op, Alter(str, group, array));
+
+    return RulesDef(d_ch, d_str, d_op, d_group, d_array);
+}
+
+/**
+ * @brief Compare two token sequences by values and by each of the token types
+ */
+template<class TokensA, class TokensB>
+bool same_tokens(const TokensA& lhs, const TokensB& rhs)
+{
+    if (lhs.size() != rhs.size()) return false;
+    for (std::size_t i = 0; i < lhs.size(); i++)
+    {
+        if (lhs[i].value != rhs[i].value || lhs[i].type.size() != rhs[i].type.size()) return false;
+        for (std::size_t j = 0; j < lhs[i].type.size(); j++)
+            if (lhs[i].type[j] != rhs[i].type[j]) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Parser callback for same_parses(), which lexes the input, parses it and serializes the tree
+ * @tparam Tree Tree type of the parser
+ * @param session Optional parse session, which is kept between the runs
+ */
+template<class VStr, class Tree = TreeNode<VStr>, class Lexer, class Parser, class Root, class... Session>
+auto parse_runner(const Lexer& lexer, const Parser& parser, const Root& root, Session&... session)
+{
+    return [&lexer, &parser, root, &session...](const VStr& in, VStr& wire){
+        bool ok;
+        auto tokens = lexer.run(in, ok);
+        Tree tree;
+        ok = ok && parser.run(tree, root, tokens, session...);
+        if constexpr (is_flat_tree_v<Tree>)
+            wire = serialize_ast_wire<VStr, typename Tree::NodeView>(tree.root());
+        else
+            wire = serialize_ast_wire<VStr, Tree>(tree);
+        return ok;
+    };
+}
+
+/**
+ * @brief Parse each input with the baseline and with each variant, the results and the trees should be equal
+ * @param inputs Inputs with the expected result
+ * @param baseline Callback (const VStr& in, VStr& wire) -> bool, see parse_runner()
+ */
+template<class VStr, class Baseline, class... Variants>
+bool same_parses(const std::vector<std::pair<std::string, bool>>& inputs, const Baseline& baseline, const Variants&... variants)
+{
+    for (const auto& [text, expected] : inputs)
+    {
+        const VStr in(text);
+        VStr wire;
+        const bool ok = baseline(in, wire);
+        auto same = [&](const auto& variant){
+            VStr variant_wire;
+            return variant(in, variant_wire) == ok && variant_wire == wire;
+        };
+        if (ok != expected || !(same(variants) && ...))
+        {
+            std::cout << "parser output mismatch on " << text << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief same_parses() over the parser configurations : the baseline and the variants are built from the same grammar and lexer
+ */
+template<class VStr, class TokenType, class Rules, class Lexer, class Root, class BaseConf, class... Confs>
+bool same_parses_confs(const Rules& ruleset, const Lexer& lexer, const Root& root, const std::vector<std::pair<std::string, bool>>& inputs, BaseConf base, Confs... confs)
+{
+    const auto baseline = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, base);
+    const auto variants = std::make_tuple(make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, confs)...);
+    return std::apply([&](const auto&... parsers){
+        return same_parses<VStr>(inputs, parse_runner<VStr>(lexer, baseline, root), parse_runner<VStr>(lexer, parsers, root)...);
+    }, variants);
+}
+
+
 bool test_gbnf_basic()
 {
     std::cout << "test_gbnf_basic() :" << std::endl;
@@ -548,9 +655,1217 @@ bool test_heuristic_ctx_init()
 }
 
 
+bool test_dfa_lexer()
+{
+    std::cout << "test_dfa_lexer() :" << std::endl;
+
+    constexpr auto ruleset = nested_lists_grammar();
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto dfa_lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::DFALexer, LexerConfEnum::HandleDuplicates>());
+
+    for (const auto& in : {VStr("(abc,asdf,[a,(gfds,sdf)])"), VStr("(abc,#)")})
+    {
+        bool ok, dfa_ok;
+        auto tokens = lexer.run(in, ok);
+        auto dfa_tokens = dfa_lexer.run(in, dfa_ok);
+
+        if (ok != dfa_ok || !same_tokens(tokens, dfa_tokens))
+        {
+            std::cout << "dfa lexer output mismatch" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool test_str_view()
+{
+    std::cout << "test_str_view() :" << std::endl;
+
+    constexpr auto value = NTerm(cs<"value">());
+    constexpr auto array = NTerm(cs<"array">());
+    constexpr auto d_value = Define(value, Alter(Term(cs<"true">()), Term(cs<"false">()), Term(cs<"null">()), array));
+    constexpr auto d_array = Define(array, Concat(Term(cs<"[">()), value, Repeat(Concat(Term(cs<",">()), value)), Term(cs<"]">())));
+
+    constexpr auto ruleset = RulesDef(d_value, d_array);
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    const VStr in("[true,[null,false],[[true]],false,null]");
+    const std::string_view text(in);
+
+    // Slices reference the source
+    const auto slice = StrView<char>::from_slice(text, 1, 5);
+    if (slice.data() != in.data() + 1 || slice != "true")
+    {
+        std::cout << "view slice mismatch" << std::endl;
+        return false;
+    }
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::DFALexer, LexerConfEnum::HandleDuplicates>());
+    auto view_lexer = make_lexer<StrView<char>, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::DFALexer, LexerConfEnum::HandleDuplicates>());
+    auto parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead>());
+    auto view_parser = make_sr_parser<StrView<char>, TokenType, TreeNode<VStr>>(ruleset, view_lexer, mk_sr_parser_conf<SRConfEnum::Lookahead>());
+
+    bool ok, view_ok;
+    auto tokens = lexer.run(in, ok);
+    auto view_tokens = view_lexer.run(in, view_ok);
+    if (!ok || !view_ok || tokens.size() != view_tokens.size())
+    {
+        std::cout << "view lexer output mismatch" << std::endl;
+        return false;
+    }
+    for (std::size_t i = 0; i < tokens.size(); i++)
+    {
+        const auto& v = view_tokens[i].value;
+        if (v.data() < text.data() || v.data() + v.size() > text.data() + text.size() || std::string_view(v) != std::string_view(tokens[i].value))
+        {
+            std::cout << "view token " << i << " does not reference the input" << std::endl;
+            return false;
+        }
+    }
+
+    // Views are looked up in the symbols hashtable without an owning key
+    const bool found = view_parser.symbols_ht.get_term(StrView<char>::from_slice(text, 7, 11), [](const auto& term){ return VStr(term.type()) == VStr("null"); });
+
+    // Wide keys are viewed with their own character type, other keys are hashed as is
+    TypesHashTable<StdStr<wchar_t>, std::tuple<int, double>> wide_ht;
+    wide_ht.insert(StdStr<wchar_t>(L"null"), 1);
+    wide_ht.insert(StdStr<wchar_t>(L"n"), 2.0);
+    TypesHashTable<int, std::tuple<int, double>> int_ht;
+    int_ht.insert(7, 1.0);
+    const bool keys_found = wide_ht.get(std::wstring_view(L"null"), [](const auto& v){ return v == 1; }) && wide_ht.get(StdStr<wchar_t>(L"n"), [](const auto& v){ return v == 2.0; }) &&
+        int_ht.contains(7) && !int_ht.contains(8);
+    if (!keys_found)
+    {
+        std::cout << "generic key lookup error" << std::endl;
+        return false;
+    }
+
+    TreeNode<VStr> tree, view_tree;
+    ok = parser.run(tree, value, tokens);
+    view_ok = view_parser.run(view_tree, value, view_tokens);
+    if (!found || !ok || !view_ok || serialize_ast_wire<VStr, TreeNode<VStr>>(tree) != serialize_ast_wire<VStr, TreeNode<VStr>>(view_tree))
+    {
+        std::cout << "view parser output mismatch" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool test_symbol_id()
+{
+    std::cout << "test_symbol_id() :" << std::endl;
+
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto ruleset = nested_lists_grammar();
+
+    using VStr = StdStr<char>;
+    using TokenType = SymbolId<decltype(ruleset)>; // Integer symbol ids instead of strings
+
+    static_assert(TokenType(cs<"char">()).id == 0 && TokenType::nterms_size() == 5, "Defined nonterminals should have the first ids");
+    static_assert(TokenType(cs<"(">()).id >= TokenType::nterms_size(), "Terminals should follow the nonterminals");
+
+    // Runtime lookups : range characters have their own ids, unknown names are npos
+    if (TokenType('q').name() != "q" || TokenType('q').id < TokenType::nterms_size() ||
+        TokenType(std::string_view("missing")).id != TokenType::npos || !TokenType(std::string_view("missing")).name().empty())
+    {
+        std::cout << "symbol id lookup error" << std::endl;
+        return false;
+    }
+
+    auto lexer = make_lexer<VStr, StdStr<char>>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto id_lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+
+    // Ids index the type bitsets directly in the optimized paths, PrettyPrint runs the full search
+    auto compare = [&](const auto conf) -> bool {
+        auto parser = make_sr_parser<VStr, StdStr<char>, TreeNode<VStr>>(ruleset, lexer, conf);
+        auto id_parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, id_lexer, conf);
+
+        VStr nested("q");
+        for (std::size_t i = 0; i < 40; i++)
+            nested = VStr(i % 2 ? "(" : "[") + nested + VStr(",z") + VStr(i % 2 ? ")" : "]");
+
+        // A single token, an invalid input and a deep input
+        return same_parses<VStr>({{"q", true}, {"(abc,[a)", false}, {nested, true}}, parse_runner<VStr>(lexer, parser, op), parse_runner<VStr>(id_lexer, id_parser, op));
+    };
+    return compare(mk_sr_parser_conf<SRConfEnum::PrettyPrint, SRConfEnum::Lookahead>()) && compare(mk_sr_parser_conf<SRConfEnum::Lookahead>());
+}
+
+
+bool test_flat_tree()
+{
+    std::cout << "test_flat_tree() :" << std::endl;
+
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto ruleset = nested_lists_grammar();
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    constexpr auto conf = mk_sr_parser_conf<SRConfEnum::PrettyPrint, SRConfEnum::Lookahead>();
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, conf);
+    auto flat_parser = make_sr_parser<VStr, TokenType, FlatTree<VStr>>(ruleset, lexer, conf);
+
+    // The second input is not valid, the unreduced symbols are kept as the root children
+    return same_parses<VStr>({{"(abc,asdf,[a,(gfds,sdf)])", true}, {"(abc,[a,(gfds,sdf))", false}},
+                             parse_runner<VStr>(lexer, parser, op), parse_runner<VStr, FlatTree<VStr>>(lexer, flat_parser, op));
+}
+
+bool test_lazy_automaton()
+{
+    std::cout << "test_lazy_automaton() :" << std::endl;
+
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto ruleset = nested_lists_grammar();
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead>());
+    auto lazy_parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead, SRConfEnum::LazyAutomaton>());
+    auto small_parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead, SRConfEnum::LazyAutomaton>());
+    auto lazy_session = lazy_parser.make_session();
+    auto small_session = small_parser.make_session();
+    small_session.automaton.set_capacity(4); // Full after the first states
+
+    // Repeated structures
+    VStr repeated("[x");
+    for (std::size_t i = 0; i < 50; i++) repeated += VStr(",(ab,[cd,ef])");
+    repeated += VStr("]");
+
+    // The automaton is kept between the runs : a state seen with a lookahead is also reached at the end of input ("ab" is a prefix of "ab,c"),
+    // and the cached decisions should not accept an invalid input
+    if (!same_parses<VStr>({{repeated, true}, {"ab,c", false}, {"ab", true}, {"[ab,(cd,ef)", false}, {repeated, true}}, parse_runner<VStr>(lexer, parser, op),
+                           parse_runner<VStr>(lexer, lazy_parser, op, lazy_session), parse_runner<VStr>(lexer, small_parser, op, small_session)))
+        return false;
+    std::cout << "automaton states : " << lazy_session.automaton.size() << ", hit ratio : " << lazy_session.automaton.hit_ratio() << std::endl;
+    if (lazy_session.automaton.hit_ratio() < 0.5 || small_session.automaton.size() > 4)
+    {
+        std::cout << "automaton is not reused" << std::endl;
+        return false;
+    }
+
+    // Words of a range share the token class, so the states are reused even if no word repeats
+    VStr varied("[x");
+    for (std::size_t i = 0; i < 50; i++)
+    {
+        std::string chars;
+        for (std::size_t j = 0; j <= i % 4; j++) chars += static_cast<char>('a' + (i * 7 + j * 3) % 26);
+        const VStr word(chars.c_str());
+        varied += VStr(",(") + word + VStr(",[") + word + VStr("b,c") + word + VStr("])");
+    }
+    varied += VStr("]");
+
+    auto varied_session = lazy_parser.make_session();
+    if (!same_parses<VStr>({{varied, true}}, parse_runner<VStr>(lexer, parser, op), parse_runner<VStr>(lexer, lazy_parser, op, varied_session)))
+        return false;
+    std::cout << "automaton states on distinct words : " << varied_session.automaton.size() << ", hit ratio : " << varied_session.automaton.hit_ratio() << std::endl;
+    if (varied_session.automaton.hit_ratio() < 0.5)
+    {
+        std::cout << "automaton is not reused on distinct words" << std::endl;
+        return false;
+    }
+
+    // Decisions of RC(1) depend on the parsing history, nothing is memoized
+    auto rc_parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead, SRConfEnum::ReducibilityChecker, SRConfEnum::LazyAutomaton>());
+    bool ok;
+    auto tokens = lexer.run(repeated, ok);
+    TreeNode<VStr> rc_tree;
+    auto rc_session = rc_parser.make_session();
+    rc_parser.run(rc_tree, op, tokens, rc_session);
+    if (rc_session.automaton.size() != 0)
+    {
+        std::cout << "automaton is used with RC(1)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_lr_parser()
+{
+    std::cout << "test_lr_parser() :" << std::endl;
+
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto ruleset = nested_lists_grammar();
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead>());
+    auto lr_parser = make_lr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_lr_parser_conf<>());
+    auto glr_parser = make_lr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_lr_parser_conf<LRConfEnum::GLR>());
+    std::cout << "LALR(1) states : " << lr_parser.tables.n_states << ", conflicts : " << lr_parser.tables.n_conflicts << std::endl;
+
+    StdStr<char> in("(abc,asdf,[a,(gfds,sdf)])");
+    bool ok, lr_ok, glr_ok;
+    auto tokens = lexer.run(in, ok);
+
+    if (!ok)
+    {
+        std::cout << "lexer build error" << std::endl;
+        return false;
+    }
+
+    TreeNode<VStr> tree, lr_tree, glr_tree;
+    ok = parser.run(tree, op, tokens);
+    lr_ok = lr_parser.run(lr_tree, op, tokens);
+    glr_ok = glr_parser.run(glr_tree, op, tokens);
+
+    const auto wire = serialize_ast_wire<VStr, TreeNode<VStr>>(tree);
+    const auto lr_wire = serialize_ast_wire<VStr, TreeNode<VStr>>(lr_tree);
+    std::cout << "======" << std::endl << "wire ast format : " << lr_wire << std::endl;
+
+    // Strings of chars are ambiguous, so that the GSS is used
+    if (!glr_parser.has_conflicts() || !ok || !lr_ok || !glr_ok || wire != lr_wire || wire != serialize_ast_wire<VStr, TreeNode<VStr>>(glr_tree))
+    {
+        std::cout << "parser output mismatch" << std::endl;
+        return false;
+    }
+
+    // The conflict on "a" with the lookahead "b" needs two tokens of lookahead, shift is the wrong choice for "abd"
+    constexpr auto s = NTerm(cs<"s">());
+    constexpr auto x = NTerm(cs<"x">());
+    constexpr auto d_s = Define(s, Alter(Concat(Term(cs<"a">()), Term(cs<"b">()), Term(cs<"c">())), Concat(x, Term(cs<"b">()), Term(cs<"d">()))));
+    constexpr auto d_x = Define(x, Term(cs<"a">()));
+    constexpr auto la_ruleset = RulesDef(d_s, d_x);
+
+    auto la_lexer = make_lexer<VStr, TokenType>(la_ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto la_lr_parser = make_lr_parser<VStr, TokenType, TreeNode<VStr>>(la_ruleset, la_lexer, mk_lr_parser_conf<>());
+    auto la_glr_parser = make_lr_parser<VStr, TokenType, TreeNode<VStr>>(la_ruleset, la_lexer, mk_lr_parser_conf<LRConfEnum::GLR>());
+
+    auto la_tokens = la_lexer.run(VStr("abd"), ok);
+    TreeNode<VStr> la_lr_tree, la_glr_tree;
+    lr_ok = la_lr_parser.run(la_lr_tree, s, la_tokens);
+    glr_ok = la_glr_parser.run(la_glr_tree, s, la_tokens);
+    const auto la_wire = serialize_ast_wire<VStr, TreeNode<VStr>>(la_glr_tree);
+    std::cout << "GLR wire ast format : " << la_wire << std::endl;
+
+    if (!ok || !la_glr_parser.has_conflicts() || lr_ok || !glr_ok || la_glr_tree.nodes.size() != 1 || la_glr_tree.nodes[0].nodes.size() != 1 || la_glr_tree.nodes[0].nodes[0].name != VStr("x"))
+    {
+        std::cout << "GLR parser output mismatch" << std::endl;
+        return false;
+    }
+
+    // Nullable symbols are skipped by a chain of nterms instead of a production per subset
+    constexpr auto opts = NTerm(cs<"opts">());
+    constexpr auto d_opts = Define(opts, Concat(
+            Optional(Term(cs<"a">())), Optional(Term(cs<"b">())), Optional(Term(cs<"c">())), Optional(Term(cs<"d">())), Optional(Term(cs<"e">())), Optional(Term(cs<"f">())),
+            Optional(Term(cs<"g">())), Optional(Term(cs<"h">())), Optional(Term(cs<"i">())), Optional(Term(cs<"j">())), Optional(Term(cs<"k">())), Optional(Term(cs<"l">())),
+            Optional(Term(cs<"m">())), Optional(Term(cs<"n">())), Optional(Term(cs<"o">())), Optional(Term(cs<"p">())), Optional(Term(cs<"q">())), Optional(Term(cs<"r">()))));
+    constexpr auto opt_ruleset = RulesDef(d_opts);
+
+    auto opt_lexer = make_lexer<VStr, TokenType>(opt_ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto opt_parser = make_lr_parser<VStr, TokenType, TreeNode<VStr>>(opt_ruleset, opt_lexer, mk_lr_parser_conf<>());
+    std::cout << "nullable chain productions : " << opt_parser.tables.grammar.prods.size() << ", conflicts : " << opt_parser.tables.n_conflicts << std::endl;
+
+    for (const auto& in_opt : {VStr("a"), VStr("bdq"), VStr("abcdefghijklmnopqr"), VStr("r")})
+    {
+        auto opt_tokens = opt_lexer.run(in_opt, ok);
+        TreeNode<VStr> opt_tree;
+        lr_ok = opt_parser.run(opt_tree, opts, opt_tokens);
+        if (!ok || !lr_ok || opt_parser.has_conflicts() || opt_parser.tables.grammar.prods.size() > 200 || opt_tree.nodes.size() != 1 || opt_tree.nodes[0].value != in_opt)
+        {
+            std::cout << "nullable chain parser error" << std::endl;
+            return false;
+        }
+    }
+
+    // Each split of a sum is a derivation. The parser is shared read-only and the runs reuse one session
+    constexpr auto e = NTerm(cs<"e">());
+    constexpr auto d_e = Define(e, Alter(Concat(e, Term(cs<"+">()), e), Term(cs<"a">())));
+    constexpr auto sum_ruleset = RulesDef(d_e);
+
+    auto sum_lexer = make_lexer<VStr, TokenType>(sum_ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    const auto sum_parser = make_lr_parser<VStr, TokenType, TreeNode<VStr>>(sum_ruleset, sum_lexer, mk_lr_parser_conf<LRConfEnum::GLR>());
+    auto session = sum_parser.make_session();
+
+    VStr sum("a");
+    for (std::size_t i = 0; i < 40; i++) sum += VStr("+a");
+    for (const VStr& in_sum : {sum, VStr("a+a"), VStr("a+"), sum})
+    {
+        auto sum_tokens = sum_lexer.run(in_sum, ok);
+        TreeNode<VStr> sum_tree;
+        glr_ok = ok && sum_parser.run(sum_tree, e, sum_tokens, session);
+        if (!sum_parser.has_conflicts() || glr_ok != (in_sum != VStr("a+")) || (glr_ok && (sum_tree.nodes.size() != 1 || sum_tree.nodes[0].name != VStr("e"))))
+        {
+            std::cout << "ambiguous GLR parser error on " << in_sum << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool test_parse_session()
+{
+    std::cout << "test_parse_session() :" << std::endl;
+
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto ruleset = nested_lists_grammar();
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+
+    // The context manager asserts on a group or array in the first position, so nest in the middle
+    VStr deep("a");
+    for (std::size_t i = 0; i < 30; i++) deep = VStr("(x,") + deep + VStr(",[b,c])");
+
+    // The invalid input leaves the heuristics context in the middle of a rule
+    bool lex_ok;
+    std::vector<decltype(lexer.run(deep, lex_ok))> inputs;
+    for (const VStr& in : {VStr("(abc,asdf,[a,(gfds,sdf)])"), VStr("[a,(b,[c"), VStr("[a,b,(c,[d,e]),f]"), deep})
+    {
+        inputs.push_back(lexer.run(in, lex_ok));
+        if (!lex_ok)
+        {
+            std::cout << "lexer build error" << std::endl;
+            return false;
+        }
+    }
+
+    // RC(1) and the context manager keep their state in the session
+    auto check = [&](const auto conf) -> bool {
+        auto parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, conf);
+        const auto& shared = parser; // The parser is shared read-only
+
+        auto wire = [](bool ok, const TreeNode<VStr>& tree) -> std::string {
+            return ok ? serialize_ast_wire<VStr, TreeNode<VStr>>(tree) : std::string("error");
+        };
+        auto parse_all = [&](auto& session, std::vector<std::string>& wires){
+            for (auto& tokens : inputs)
+            {
+                TreeNode<VStr> tree;
+                const bool ok = shared.run(tree, op, tokens, session);
+                wires.push_back(wire(ok, tree));
+            }
+        };
+
+        // Fresh session for each input
+        std::vector<std::string> expected, reused;
+        for (auto& tokens : inputs)
+        {
+            auto fresh = shared.make_session();
+            TreeNode<VStr> tree;
+            const bool ok = shared.run(tree, op, tokens, fresh);
+            expected.push_back(wire(ok, tree));
+        }
+
+        // One session for all inputs, including the one after the error
+        auto session = shared.make_session();
+        parse_all(session, reused);
+
+        // Concurrent runs
+        std::vector<std::vector<std::string>> results(4);
+        std::vector<std::thread> workers;
+        for (auto& res : results)
+            workers.emplace_back([&]{ auto s = shared.make_session(); parse_all(s, res); });
+        for (auto& w : workers) w.join();
+
+        bool same = reused == expected && expected[1] == "error";
+        for (const auto& res : results) same = same && res == expected;
+        return same;
+    };
+
+    if (!check(mk_sr_parser_conf<SRConfEnum::Lookahead, SRConfEnum::HeuristicCtx>()) ||
+        !check(mk_sr_parser_conf<SRConfEnum::Lookahead, SRConfEnum::ReducibilityChecker, SRConfEnum::RC1CheckContext>()))
+    {
+        std::cout << "session results differ" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_parse_batch()
+{
+    std::cout << "test_parse_batch() :" << std::endl;
+
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto ruleset = nested_lists_grammar();
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead>());
+    auto batch = make_batch_parser<TreeNode<VStr>>(lexer, parser, 4);
+
+    std::vector<StdStr<char>> inputs;
+    for (std::size_t i = 0; i < 64; i++)
+        inputs.emplace_back(i % 3 == 0 ? "(abc,asdf,[a,(gfds,sdf)])" : (i % 3 == 1 ? "[a,b,(c,[d,e]),f]" : "(a,"));
+
+    // The workers and their sessions are reused by the next batches, which may be smaller than the pool
+    std::vector<decltype(batch)::Result> results;
+    for (const std::size_t n : {inputs.size(), std::size_t(2), std::size_t(0), inputs.size() - 1})
+    {
+        const std::vector<StdStr<char>> batch_inputs(inputs.end() - n, inputs.end());
+        batch.parse_batch(op, batch_inputs, results);
+        if (results.size() != n)
+        {
+            std::cout << "batch size mismatch" << std::endl;
+            return false;
+        }
+
+        for (std::size_t i = 0; i < n; i++)
+        {
+            bool ok;
+            auto tokens = lexer.run(batch_inputs[i], ok);
+            TreeNode<VStr> tree;
+            ok = ok && parser.run(tree, op, tokens);
+            if (ok != results[i].ok || serialize_ast_wire<VStr, TreeNode<VStr>>(tree) != serialize_ast_wire<VStr, TreeNode<VStr>>(results[i].tree))
+            {
+                std::cout << "parser output mismatch at input " << i << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool test_stream_parser()
+{
+    std::cout << "test_stream_parser() :" << std::endl;
+
+    constexpr auto ch = NTerm(cs<"char">());
+    constexpr auto d_ch = Define(ch, Repeat(TermsRange(cs<"a">(), cs<"z">())));
+
+    constexpr auto str = NTerm(cs<"string">());
+    constexpr auto d_str = Define(str, Repeat(ch));
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto group = NTerm(cs<"group">());
+    constexpr auto array = NTerm(cs<"array">());
+    constexpr auto stmt = NTerm(cs<"stmt">());
+
+    constexpr auto d_group = Define(group, Concat(Term(cs<"(">()), op, Repeat(Concat(Term(cs<",">()), op)), Term(cs<")">())));
+    constexpr auto d_array = Define(array, Concat(Term(cs<"[">()), op, Repeat(Concat(Term(cs<",">()), op)), Term(cs<"]">())));
+    constexpr auto d_op = Define(op, Alter(str, group, array));
+    constexpr auto d_stmt = Define(stmt, Concat(op, Term(cs<";">())));
+
+    constexpr auto ruleset = RulesDef(d_ch, d_str, d_op, d_group, d_array, d_stmt);
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead>());
+
+    const std::vector<StdStr<char>> items = {StdStr<char>("(abc,asdf,[a,(gfds,sdf)]);"), StdStr<char>("[a,b,(c,[d,e]),f];"), StdStr<char>("xyz;")};
+
+    // Each statement parsed on its own
+    std::vector<std::string> expected;
+    StdStr<char> in;
+    for (std::size_t k = 0; k < 12; k++)
+    {
+        const auto& item = items[k % items.size()];
+        bool ok;
+        auto tokens = lexer.run(item, ok);
+        TreeNode<VStr> tree;
+        if (!ok || !parser.run(tree, stmt, tokens))
+        {
+            std::cout << "batch parse error" << std::endl;
+            return false;
+        }
+        expected.push_back(serialize_ast_wire<VStr, TreeNode<VStr>>(tree));
+        in += item;
+    }
+
+    bool ok;
+    auto tokens = lexer.run(in, ok);
+    if (!ok)
+    {
+        std::cout << "lexer build error" << std::endl;
+        return false;
+    }
+
+    // The same statements are pushed in uneven chunks
+    std::vector<std::string> streamed;
+    std::size_t max_buffered = 0;
+    auto session = parser.make_stream_session(stmt, [&](TreeNode<VStr>& tree){ streamed.push_back(serialize_ast_wire<VStr, TreeNode<VStr>>(tree)); });
+    for (std::size_t pos = 0, len = 1; pos < tokens.size(); pos += len, len = len % 5 + 1)
+    {
+        session->feed(decltype(tokens)(tokens.begin() + pos, tokens.begin() + std::min(pos + len, tokens.size())));
+        max_buffered = std::max(max_buffered, session->buffered());
+    }
+    ok = session->finish();
+
+    std::cout << "stream items : " << streamed.size() << ", max buffered tokens : " << max_buffered << std::endl;
+    if (!ok || streamed != expected || max_buffered >= tokens.size() / 2)
+    {
+        std::cout << "parser output mismatch" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_tree_builder()
+{
+    std::cout << "test_tree_builder() :" << std::endl;
+
+    constexpr auto digit = NTerm(cs<"digit">());
+    constexpr auto d_digit = Define(digit, Repeat(Alter(Term(cs<"1">()), Term(cs<"2">()), Term(cs<"3">()), Term(cs<"4">()), Term(cs<"5">()),
+                                                        Term(cs<"6">()), Term(cs<"7">()), Term(cs<"8">()), Term(cs<"9">()), Term(cs<"0">()))));
+
+    constexpr auto number = NTerm(cs<"number">());
+    constexpr auto d_number = Define(number, Repeat(digit));
+    constexpr auto add = NTerm(cs<"add">());
+    constexpr auto mul = NTerm(cs<"mul">());
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto arithmetic = NTerm(cs<"arithmetic">());
+    constexpr auto group = NTerm(cs<"group">());
+
+    constexpr auto d_add = Define(add, Concat(op, Term(cs<"+">()), op));
+    constexpr auto d_mul = Define(mul, Concat(op, Term(cs<"*">()), op));
+    constexpr auto d_group = Define(group, Concat(Term(cs<"(">()), op, Term(cs<")">())));
+    constexpr auto d_arithmetic = Define(arithmetic, Alter(add, mul));
+    constexpr auto d_op = Define(op, Alter(number, arithmetic, group));
+
+    constexpr auto ruleset = RulesDef(d_digit, d_number, d_add, d_mul, d_arithmetic, d_op, d_group);
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::Legacy>());
+    constexpr auto conf = mk_sr_parser_conf<SRConfEnum::Lookahead>();
+
+    StdStr<char> in("12*(3+42)"), in_bad("12*(3+");
+    bool ok, ok_bad;
+    auto tokens = lexer.run(in, ok);
+    auto tokens_bad = lexer.run(in_bad, ok_bad);
+    if (!ok || !ok_bad)
+    {
+        std::cout << "lexer build error" << std::endl;
+        return false;
+    }
+
+    // Recognizer
+    auto recognizer = make_sr_parser<VStr, TokenType, NullTree>(ruleset, lexer, conf);
+    NullTree null_tree;
+    ok = recognizer.run(null_tree, op, tokens);
+    ok_bad = recognizer.run(null_tree, op, tokens_bad);
+
+    // Fold over the reductions, each value is a number with its digits count
+    std::vector<std::pair<long, long>> values;
+    values.reserve(tokens.size());
+    auto calc = make_callback_tree([&](const auto& token){
+        const char c = token.value[0];
+        values.emplace_back(c >= '0' && c <= '9' ? c - '0' : 0, 1);
+    }, [&](const auto& type, std::size_t, const auto& children){
+        const auto first = values.end() - static_cast<std::ptrdiff_t>(children.size());
+        std::pair<long, long> res = *first;
+        if (type == "digit" || type == "number")
+        {
+            for (auto it = first + 1; it != values.end(); ++it)
+            {
+                for (long k = 0; k < it->second; k++) res.first *= 10;
+                res = {res.first + it->first, res.second + it->second};
+            }
+        }
+        else if (type == "add") res.first = first[0].first + first[2].first;
+        else if (type == "mul") res.first = first[0].first * first[2].first;
+        else if (type == "group") res = first[1];
+        values.erase(first, values.end());
+        values.push_back(res);
+    });
+    auto folder = make_sr_parser<VStr, TokenType, decltype(calc)>(ruleset, lexer, conf);
+    bool ok_calc = folder.run(calc, op, tokens);
+
+    std::cout << "recognizer : " << ok << ", " << ok_bad << ", fold result : " << (values.empty() ? -1 : values.back().first) << std::endl;
+    if (!ok || ok_bad || !ok_calc || values.size() != 1 || values.back().first != 12 * (3 + 42))
+    {
+        std::cout << "parser output mismatch" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_mapped_input()
+{
+    std::cout << "test_mapped_input() :" << std::endl;
+
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto ruleset = nested_lists_grammar();
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    const VStr in("(abc,asdf,[a,(gfds,sdf)])");
+    const std::string path = (std::filesystem::temp_directory_path() / "supercfg_mapped_input.txt").string();
+    std::ofstream(path, std::ios::binary) << in;
+
+    bool ok, map_ok;
+    MappedFile<char> file(path.c_str(), map_ok);
+    if (!map_ok || file.size() != in.size())
+    {
+        std::cout << "file mapping error" << std::endl;
+        return false;
+    }
+
+    // Copying lexer
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead>());
+    auto tokens = lexer.run(in, ok);
+    auto map_tokens = lexer.run(file, map_ok);
+    TreeNode<VStr> tree, map_tree;
+    ok = ok && parser.run(tree, op, tokens);
+    map_ok = map_ok && parser.run(map_tree, op, map_tokens);
+
+    // Zero-copy lexer, the tokens reference the mapping
+    auto dfa_lexer = make_lexer<StrView<char>, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::DFALexer, LexerConfEnum::HandleDuplicates>());
+    auto dfa_parser = make_sr_parser<StrView<char>, TokenType, TreeNode<VStr>>(ruleset, dfa_lexer, mk_sr_parser_conf<SRConfEnum::Lookahead>());
+    bool dfa_ok;
+    auto dfa_tokens = dfa_lexer.run(file, dfa_ok);
+    TreeNode<VStr> dfa_tree;
+    dfa_ok = dfa_ok && !dfa_tokens.empty() && dfa_tokens[0].value.data() == file.data() && dfa_parser.run(dfa_tree, op, dfa_tokens);
+
+    std::remove(path.c_str());
+
+    const auto wire = serialize_ast_wire<VStr, TreeNode<VStr>>(tree);
+    if (!ok || !map_ok || !dfa_ok || wire != serialize_ast_wire<VStr, TreeNode<VStr>>(map_tree) || wire != serialize_ast_wire<VStr, TreeNode<VStr>>(dfa_tree))
+    {
+        std::cout << "parser output mismatch" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_stream_lexer()
+{
+    std::cout << "test_stream_lexer() :" << std::endl;
+
+    constexpr auto value = NTerm(cs<"value">());
+    constexpr auto array = NTerm(cs<"array">());
+    constexpr auto d_value = Define(value, Alter(Term(cs<"true">()), Term(cs<"false">()), Term(cs<"null">()), array));
+    constexpr auto d_array = Define(array, Concat(Term(cs<"[">()), value, Repeat(Concat(Term(cs<",">()), value)), Term(cs<"]">())));
+
+    constexpr auto ruleset = RulesDef(d_value, d_array);
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto dfa_lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::DFALexer, LexerConfEnum::HandleDuplicates, LexerConfEnum::MaximalMunch>());
+
+    const VStr in("[true,[null,false],[[true]],false,null]"), in_bad("[true,nul]");
+
+    auto check = [&](const auto& lex, const VStr& text) -> bool {
+        bool ok;
+        auto tokens = lex.run(text, ok);
+
+        // Small buffer, so that the terminals are split between the chunks
+        std::istringstream stream(text);
+        std::vector<typename decltype(tokens)::value_type> stream_tokens;
+        bool stream_ok = lex.run_stream(make_istream_reader(stream), [&](auto&& tok){ stream_tokens.push_back(tok); }, 6);
+
+        return ok == stream_ok && same_tokens(tokens, stream_tokens);
+    };
+
+    // Merged runs which reach the buffer end are carried over as a whole
+    constexpr auto list_ruleset = nested_lists_grammar();
+    auto run_lexer = make_lexer<VStr, TokenType>(list_ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates, LexerConfEnum::CoalesceRuns>());
+    auto dfa_run_lexer = make_lexer<VStr, TokenType>(list_ruleset, mk_lexer_conf<LexerConfEnum::DFALexer, LexerConfEnum::HandleDuplicates, LexerConfEnum::MaximalMunch, LexerConfEnum::CoalesceRuns>());
+    const VStr run_in("(abc,asdf,[a,(gfds,sdf)],xy)"), run_in_bad("(abc,asdf,#)");
+
+    if (!check(lexer, in) || !check(lexer, in_bad) || !check(dfa_lexer, in) || !check(dfa_lexer, in_bad) ||
+        !check(run_lexer, run_in) || !check(run_lexer, run_in_bad) || !check(dfa_run_lexer, run_in) || !check(dfa_run_lexer, run_in_bad))
+    {
+        std::cout << "stream lexer output mismatch" << std::endl;
+        return false;
+    }
+
+    // A read error after a prefix which lexes cleanly is not the end of input
+    std::size_t served = 0;
+    auto failing_reader = [&](char* dst, std::size_t n) -> std::ptrdiff_t {
+        if (served >= 6) return -1;
+        const std::size_t k = std::min<std::size_t>(n, 6 - served);
+        std::copy(in.begin() + static_cast<std::ptrdiff_t>(served), in.begin() + static_cast<std::ptrdiff_t>(served + k), dst);
+        served += k;
+        return static_cast<std::ptrdiff_t>(k);
+    };
+    if (lexer.run_stream(failing_reader, [](auto&&){}, 6))
+    {
+        std::cout << "stream lexer read error is not reported" << std::endl;
+        return false;
+    }
+
+#ifdef SUPERCFG_HAS_MMAP
+    // The input fits into the pipe buffer
+    auto pipe_text = [](const std::string_view text, int fds[2]) -> bool {
+        if (::pipe(fds) != 0) return false;
+        const bool written = ::write(fds[1], text.data(), text.size()) == static_cast<ssize_t>(text.size());
+        ::close(fds[1]);
+        return written;
+    };
+
+    int fds[2];
+    bool ok;
+    auto tokens = lexer.run(in, ok);
+    std::vector<typename decltype(tokens)::value_type> fd_tokens;
+    const bool fd_ok = pipe_text(in, fds) && lexer.run_stream(make_fd_reader<char>(fds[0]), [&](auto&& tok){ fd_tokens.push_back(tok); }, 6);
+    ::close(fds[0]);
+    const bool bad_fd_ok = lexer.run_stream(make_fd_reader<char>(-1), [](auto&&){}, 6);
+
+    // The input ends inside a two-byte character
+    char16_t wide[4];
+    const bool odd_piped = pipe_text("abcde", fds);
+    const auto odd_res = make_fd_reader<char16_t>(fds[0])(wide, 4);
+    ::close(fds[0]);
+    const bool even_piped = pipe_text("abcdef", fds);
+    const auto even_res = make_fd_reader<char16_t>(fds[0])(wide, 4);
+    ::close(fds[0]);
+
+    if (!ok || !fd_ok || !same_tokens(tokens, fd_tokens) || bad_fd_ok || !odd_piped || odd_res >= 0 || !even_piped || even_res != 3)
+    {
+        std::cout << "fd reader error" << std::endl;
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool test_parallel_lexer()
+{
+    std::cout << "test_parallel_lexer() :" << std::endl;
+
+    constexpr auto value = NTerm(cs<"value">());
+    constexpr auto array = NTerm(cs<"array">());
+    constexpr auto d_value = Define(value, Alter(Term(cs<"true">()), Term(cs<"false">()), Term(cs<"null">()), array));
+    constexpr auto d_array = Define(array, Concat(Term(cs<"[">()), value, Repeat(Concat(Term(cs<",">()), value)), Term(cs<"]">())));
+
+    constexpr auto ruleset = RulesDef(d_value, d_array);
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto dfa_lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::DFALexer, LexerConfEnum::HandleDuplicates, LexerConfEnum::MaximalMunch>());
+
+    VStr in("["), in_bad;
+    for (std::size_t i = 0; i < 200; i++)
+        in += (i % 3 == 0 ? "true," : (i % 3 == 1 ? "[null,false]," : "[[true]],"));
+    in += "null]";
+    in_bad = in;
+    in_bad[in.size() / 2] = '#';
+
+    auto check = [&](const auto& lex, const VStr& text) -> bool {
+        bool ok, par_ok;
+        auto tokens = lex.run(text, ok);
+        // Small chunks, so that most of them start inside a terminal
+        auto par_tokens = lex.run_parallel(text, par_ok, 8, 7);
+
+        return ok == par_ok && same_tokens(tokens, par_tokens);
+    };
+
+    // Merged runs may span several chunks
+    constexpr auto list_ruleset = nested_lists_grammar();
+    auto run_lexer = make_lexer<VStr, TokenType>(list_ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates, LexerConfEnum::CoalesceRuns>());
+    auto dfa_run_lexer = make_lexer<VStr, TokenType>(list_ruleset, mk_lexer_conf<LexerConfEnum::DFALexer, LexerConfEnum::HandleDuplicates, LexerConfEnum::MaximalMunch, LexerConfEnum::CoalesceRuns>());
+    VStr run_in("("), run_in_bad;
+    for (std::size_t i = 0; i < 100; i++)
+        run_in += (i % 3 == 0 ? "abc," : (i % 3 == 1 ? "[a,(gfds,sdf)]," : "lexerrunsaremergedintoonetoken,"));
+    run_in += "x)";
+    run_in_bad = run_in;
+    run_in_bad[run_in.size() / 2] = '#';
+
+    if (!check(lexer, in) || !check(lexer, in_bad) || !check(dfa_lexer, in) || !check(dfa_lexer, in_bad) ||
+        !check(run_lexer, run_in) || !check(run_lexer, run_in_bad) || !check(dfa_run_lexer, run_in) || !check(dfa_run_lexer, run_in_bad))
+    {
+        std::cout << "parallel lexer output mismatch" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_byte_runs()
+{
+    std::cout << "test_byte_runs() :" << std::endl;
+
+    constexpr auto word = NTerm(cs<"word">());
+    constexpr auto num = NTerm(cs<"num">());
+    constexpr auto item = NTerm(cs<"item">());
+    constexpr auto list = NTerm(cs<"list">());
+    constexpr auto d_word = Define(word, Repeat(TermsRange(cs<"a">(), cs<"z">())));
+    constexpr auto d_num = Define(num, Repeat(TermsRange(cs<"0">(), cs<"9">())));
+    constexpr auto d_item = Define(item, Alter(word, num));
+    constexpr auto d_list = Define(list, Concat(item, Repeat(Concat(Alter(Term(cs<" ">()), Term(cs<"<">()), Term(cs<"<=">())), item))));
+
+    constexpr auto ruleset = RulesDef(d_word, d_num, d_item, d_list);
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto dfa_lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::DFALexer, LexerConfEnum::HandleDuplicates, LexerConfEnum::MaximalMunch>());
+
+    // Runs longer than the vector width, and runs which are cut by a longer terminal
+    VStr in;
+    for (std::size_t i = 0; i < 20; i++)
+        in += (i % 2 == 0 ? "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz 0123456789012345678901234567890123 " : "x<=7<q ");
+    in += "z";
+
+    bool ok;
+    std::size_t n_le = 0;
+    for (std::size_t i = 0; i + 1 < in.size(); i++)
+        if (in[i] == '<' && in[i + 1] == '=') n_le++;
+
+    auto check = [&](const auto& tokens, const VStr& text, std::size_t expected) -> bool {
+        if (!ok || tokens.size() != expected) return false;
+        VStr joined;
+        for (const auto& tok : tokens)
+        {
+            joined += tok.value;
+            if (tok.value.size() == 1 && tok.value[0] >= '0' && tok.value[0] <= '9' && tok.type.size() != 1) return false;
+        }
+        return joined == text;
+    };
+
+    // The first match lexer never emits "<="
+    VStr in_first = in;
+    std::replace(in_first.begin(), in_first.end(), '=', '<');
+    auto tokens = lexer.run(in_first, ok);
+    if (!check(tokens, in_first, in_first.size()))
+    {
+        std::cout << "lexer byte runs mismatch" << std::endl;
+        return false;
+    }
+    // Maximal munch keeps "<=" whole, so '<' is not scanned as a run
+    auto dfa_tokens = dfa_lexer.run(in, ok);
+    if (!check(dfa_tokens, in, in.size() - n_le))
+    {
+        std::cout << "DFA lexer byte runs mismatch" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_coalesce_runs()
+{
+    std::cout << "test_coalesce_runs() :" << std::endl;
+
+    constexpr auto ch = NTerm(cs<"char">());
+    constexpr auto d_ch = Define(ch, Repeat(TermsRange(cs<"a">(), cs<"z">())));
+    constexpr auto str = NTerm(cs<"string">());
+    constexpr auto d_str = Define(str, Repeat(ch));
+    constexpr auto op = NTerm(cs<"op">());
+    constexpr auto group = NTerm(cs<"group">());
+    constexpr auto d_group = Define(group, Concat(Term(cs<"(">()), op, Repeat(Concat(Term(cs<",">()), op)), Term(cs<")">())));
+    constexpr auto d_op = Define(op, Alter(str, group));
+
+    constexpr auto ruleset = RulesDef(d_ch, d_str, d_op, d_group);
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto run_lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates, LexerConfEnum::CoalesceRuns>());
+
+    constexpr auto conf = mk_sr_parser_conf<SRConfEnum::Lookahead>();
+    auto parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, conf);
+
+    VStr in("(abc,(xyzzy,q),lexerrunsaremergedintoonetoken)");
+    bool ok;
+
+    // Returns the tree dump and the number of tokens
+    auto parse = [&](const auto& lex) -> std::pair<std::string, std::size_t> {
+        auto tokens = lex.run(in, ok);
+        if (!ok) return {};
+        TreeNode<VStr> tree;
+        ok = parser.run(tree, op, tokens);
+        std::string dump;
+        tree.traverse([&](const auto& node, std::size_t depth){ dump += std::to_string(depth) + node.name + ":" + node.value + ";"; });
+        return {dump, tokens.size()};
+    };
+
+    const auto [dump, n_tokens] = parse(lexer);
+    const auto [run_dump, n_runs] = parse(run_lexer);
+    if (!ok || dump != run_dump || n_runs != 11)
+    {
+        std::cout << "coalesced runs produce a different tree : " << n_runs << " tokens" << std::endl << run_dump << std::endl;
+        return false;
+    }
+    std::cout << n_tokens << " -> " << n_runs << " tokens" << std::endl;
+
+    // A multi-character terminal is not a run, so it does not match a repeat over its characters
+    constexpr auto x = NTerm(cs<"x">());
+    constexpr auto d_x = Define(x, Alter(Concat(Term(cs<"(">()), Repeat(Alter(Term(cs<"a">()), Term(cs<"b">()))), Term(cs<")">())),
+                                         Concat(Term(cs<"(">()), Term(cs<"ab">()), Term(cs<"!">()), Term(cs<")">()))));
+    constexpr auto term_ruleset = RulesDef(d_x);
+
+    auto term_lexer = make_lexer<VStr, TokenType>(term_ruleset, mk_lexer_conf<LexerConfEnum::DFALexer, LexerConfEnum::HandleDuplicates, LexerConfEnum::MaximalMunch>());
+    auto term_parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(term_ruleset, term_lexer, conf);
+    auto accepts = [&](const char* text){
+        auto tokens = term_lexer.run(VStr(text), ok);
+        TreeNode<VStr> tree;
+        return ok && term_parser.run(tree, x, tokens);
+    };
+    if (!accepts("(ab!)") || !accepts("(a)") || accepts("(ab)"))
+    {
+        std::cout << "terminal is split into a run" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_range_lookup()
+{
+    std::cout << "test_range_lookup() :" << std::endl;
+
+    constexpr auto ident = NTerm(cs<"ident">());
+    constexpr auto sign = NTerm(cs<"sign">());
+    constexpr auto d_sign = Define(sign, Alter(Term(cs<"+">()), Term(cs<"m">())));
+    constexpr auto d_ident = Define(ident, Repeat(Alter(TermsRange(cs<"a">(), cs<"z">()), TermsRange(cs<" ">(), cs<"~">()))));
+
+    constexpr auto ruleset = RulesDef(d_sign, d_ident);
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto ht = symbols_ht_factory<TokenType>(ruleset, lexer.all_terms());
+
+    // Ranges do not add a key per character, the term inserted first takes precedence over the ranges
+    auto kind = [&](const char* c){
+        return ht.get_term(TokenType(c), [](const auto& term){ return is_terms_range<std::decay_t<decltype(term)>>() ? 1 : 0; });
+    };
+    if (ht.terms_map.keys.size() > 4 || kind("m") != 0 || kind("+") != 0 || kind("q") != 1 || kind("~") != 1)
+    {
+        std::cout << "range lookup error" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_rule_bounds()
+{
+    std::cout << "test_rule_bounds() :" << std::endl;
+
+    constexpr auto digit = NTerm(cs<"digit">());
+    constexpr auto pair = NTerm(cs<"pair">());
+    constexpr auto list = NTerm(cs<"list">());
+    constexpr auto d_digit = Define(digit, TermsRange(cs<"0">(), cs<"9">()));
+    constexpr auto d_pair = Define(pair, Concat(Term(cs<"<">()), digit, Term(cs<":">()), digit, Term(cs<">">())));
+    constexpr auto d_list = Define(list, Concat(Term(cs<"[">()), pair, Repeat(Concat(Term(cs<";">()), pair)), Term(cs<"]">())));
+
+    constexpr auto ruleset = RulesDef(d_digit, d_pair, d_list);
+    using Rules = std::decay_t<decltype(ruleset)>;
+
+    constexpr auto pair_b = RuleProgram<std::decay_t<decltype(std::get<1>(d_pair.terms))>, Rules>::bounds;
+    constexpr auto list_b = RuleProgram<std::decay_t<decltype(std::get<1>(d_list.terms))>, Rules>::bounds;
+    constexpr auto opt_b = RuleProgram<decltype(Concat(Optional(Term(cs<"(">())), digit, Optional(digit))), Rules>::bounds;
+    static_assert(pair_b.min_len == 5 && pair_b.max_len == 5);
+    static_assert(list_b.min_len == 3 && list_b.max_len == RuleBounds<1>::unbounded);
+    static_assert(pair_b.first.test('<') && pair_b.first.count() == 1 && pair_b.last.test('>') && pair_b.last.count() == 1);
+    static_assert(opt_b.min_len == 1 && opt_b.max_len == 3);
+    static_assert(opt_b.first.test('(') && opt_b.first.test(256) && opt_b.last.test(256) && opt_b.last.count() == 1);
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead>());
+
+    bool ok;
+    auto tokens = lexer.run(VStr("[<1:2>;<3:4>;<5:6>]"), ok);
+    TreeNode<VStr> tree;
+    if (!ok || !parser.run(tree, list, tokens))
+    {
+        std::cout << "parser error" << std::endl;
+        return false;
+    }
+
+    // Without repeats each rule is bounded, and the windows longer than any rule are skipped. PrettyPrint visits every window
+    constexpr auto item = NTerm(cs<"item">());
+    constexpr auto tuple = NTerm(cs<"tuple">());
+    constexpr auto d_tuple = Define(tuple, Concat(Term(cs<"(">()), item, Term(cs<",">()), item, Term(cs<")">())));
+    constexpr auto d_item = Define(item, Alter(pair, tuple));
+    constexpr auto bounded = RulesDef(d_digit, d_pair, d_tuple, d_item);
+    using BoundedRules = std::decay_t<decltype(bounded)>;
+    static_assert(RuleProgram<std::decay_t<decltype(std::get<1>(d_tuple.terms))>, BoundedRules>::bounds.max_len == 5 &&
+                  RuleProgram<std::decay_t<decltype(std::get<1>(d_item.terms))>, BoundedRules>::bounds.max_len == 1);
+
+    auto bounded_lexer = make_lexer<VStr, TokenType>(bounded, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    return same_parses_confs<VStr, TokenType>(bounded, bounded_lexer, item,
+                                              {{"<1:2>", true}, {"((<1:2>,<3:4>),<5:6>)", true}, {"(<1:2>,(<3:4>,(<5:6>,<7:8>)))", true},
+                                               {"(<1:2>,<3>)", false}, {"((<1:2>,<3:4>)", false}, {"(<1:2>,<3:4>))", false}},
+                                              mk_sr_parser_conf<SRConfEnum::PrettyPrint, SRConfEnum::Lookahead>(), mk_sr_parser_conf<SRConfEnum::Lookahead>(),
+                                              mk_sr_parser_conf<SRConfEnum::Lookahead, SRConfEnum::LazyAutomaton>());
+}
+
+bool test_handle_automaton()
+{
+    std::cout << "test_handle_automaton() :" << std::endl;
+
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto ruleset = nested_lists_grammar();
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+
+    return same_parses_confs<VStr, TokenType>(ruleset, lexer, op, {{"(abc,asdf,[a,(gfds,sdf)],[ab,(cd,ef)])", true}, {"(abc,[a,(gfds,sdf))", false}},
+                                              mk_sr_parser_conf<SRConfEnum::Lookahead>(), mk_sr_parser_conf<SRConfEnum::Lookahead, SRConfEnum::HandleAutomaton>());
+}
+
+bool test_follow_matrix()
+{
+    std::cout << "test_follow_matrix() :" << std::endl;
+
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto ruleset = nested_lists_grammar();
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    // The dense matrix should agree with the FOLLOW set tuples
+    auto look = simple_lookahead_factory(reverse_rules_tree_factory(ruleset), NTermsConstHashTable(ruleset));
+    using Look = decltype(look);
+    bool same = true;
+    tuple_each(look.follow_set.defs, [&](std::size_t i, const auto& match){
+        tuple_each(look.follow_set.defs, [&](std::size_t j, const auto& next){
+            typename Look::FollowRow row;
+            row.set(Look::template nterm_id<std::decay_t<decltype(next)>>());
+            same = same && look.follows(Look::template nterm_id<std::decay_t<decltype(match)>>(), row) == !look.can_reduce(match, next);
+        });
+    });
+    if (!same)
+    {
+        std::cout << "FOLLOW matrix mismatch" << std::endl;
+        return false;
+    }
+
+    // LA(2) should not change the results of LA(1) on this grammar
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    if (!same_parses_confs<VStr, TokenType>(ruleset, lexer, op, {{"(abc,asdf,[a,(gfds,sdf)],[ab,(cd,ef)])", true}, {"(abc,[a,(gfds,sdf))", false}},
+                                            mk_sr_parser_conf<SRConfEnum::Lookahead>(), mk_sr_parser_conf<SRConfEnum::Lookahead, SRConfEnum::Lookahead2>()))
+        return false;
+
+    // "!" is typed both post and bang, and post may follow num. LA(1) prevents the reduction of num in "[n!#",
+    // LA(2) sees that "#" cannot follow post and parses it like the parser without lookahead
+    constexpr auto num = NTerm(cs<"num">());
+    constexpr auto post = NTerm(cs<"post">());
+    constexpr auto bang = NTerm(cs<"bang">());
+    constexpr auto tail = NTerm(cs<"tail">());
+    constexpr auto wrap = NTerm(cs<"wrap">());
+    constexpr auto call = NTerm(cs<"call">());
+    constexpr auto item = NTerm(cs<"item">());
+    constexpr auto stmt = NTerm(cs<"stmt">());
+    constexpr auto d_num = Define(num, Term(cs<"n">()));
+    constexpr auto d_post = Define(post, Concat(Term(cs<"!">()), Term(cs<"?">())));
+    constexpr auto d_bang = Define(bang, Concat(Term(cs<"!">()), Term(cs<"#">())));
+    constexpr auto d_tail = Define(tail, Alter(bang, Term(cs<".">())));
+    constexpr auto d_wrap = Define(wrap, Concat(Term(cs<"[">()), num));
+    constexpr auto d_call = Define(call, Concat(num, post));
+    constexpr auto d_item = Define(item, Concat(wrap, tail));
+    constexpr auto d_stmt = Define(stmt, Alter(call, item));
+    constexpr auto la_rules = RulesDef(d_num, d_post, d_bang, d_tail, d_wrap, d_call, d_item, d_stmt);
+
+    auto la_lexer = make_lexer<VStr, TokenType>(la_rules, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    if (!same_parses_confs<VStr, TokenType>(la_rules, la_lexer, stmt, {{"[n!#", true}},
+                                            mk_sr_parser_conf<>(), mk_sr_parser_conf<SRConfEnum::Lookahead, SRConfEnum::Lookahead2>()))
+        return false;
+
+    const auto la1_parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(la_rules, la_lexer, mk_sr_parser_conf<SRConfEnum::Lookahead>());
+    VStr wire;
+    if (parse_runner<VStr>(la_lexer, la1_parser, stmt)(VStr("[n!#"), wire))
+    {
+        std::cout << "LA(1) should reject the input" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_shift_only()
+{
+    std::cout << "test_shift_only() :" << std::endl;
+
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto ruleset = nested_lists_grammar();
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead, SRConfEnum::ShiftOnly>());
+
+    // Opening brackets and separators never end a rule, the parser shifts after them
+    using Parser = decltype(parser);
+    static_assert(Parser::closing_rules['('].empty() && Parser::closing_rules['['].empty() && Parser::closing_rules[','].empty());
+    static_assert(Parser::closing_rules[')'].test(3) && Parser::closing_rules[']'].test(4) && Parser::closing_rules['a'].test(0));
+    static_assert(Parser::closing_rules[256 + 1].test(2) && !Parser::closing_rules[256 + 2].test(2)); // string -> op
+
+    if (!same_parses_confs<VStr, TokenType>(ruleset, lexer, op, {{"(abc,[a,(gfds,sdf)])", true}, {"[ab,(cd,ef),[g,h,(i)],jk]", true}, {"[ab,(cd,ef)", false}},
+                                            mk_sr_parser_conf<SRConfEnum::Lookahead>(), mk_sr_parser_conf<SRConfEnum::Lookahead, SRConfEnum::ShiftOnly>()))
+        return false;
+
+    // RC(1) updates its context on each matched window, neither the trees nor the context should depend on the skipped steps
+    auto rc_parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead, SRConfEnum::ReducibilityChecker>());
+    auto rc_fast_parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead, SRConfEnum::ReducibilityChecker, SRConfEnum::ShiftOnly>());
+    for (const VStr& in : {VStr("(abc,[a,(gfds,sdf)])"), VStr("[ab,(cd,ef),[g,h,(i)],jk]"), VStr("((a,b),(c,d))"), VStr("ab,c"), VStr("[ab,(cd,ef)")})
+    {
+        bool ok;
+        auto rc_tokens = lexer.run(in, ok);
+        TreeNode<VStr> rc_tree, rc_fast_tree;
+        auto rc_session = rc_parser.make_session();
+        auto rc_fast_session = rc_fast_parser.make_session();
+        const bool rc_ok = ok && rc_parser.run(rc_tree, op, rc_tokens, rc_session);
+        const bool rc_fast_ok = ok && rc_fast_parser.run(rc_fast_tree, op, rc_tokens, rc_fast_session);
+        if (rc_ok != rc_fast_ok || serialize_ast_wire<VStr, TreeNode<VStr>>(rc_tree) != serialize_ast_wire<VStr, TreeNode<VStr>>(rc_fast_tree) ||
+            rc_session.r_checker.context != rc_fast_session.r_checker.context)
+        {
+            std::cout << "parser output mismatch with RC(1) on " << in << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool test_intersect_cache()
+{
+    std::cout << "test_intersect_cache() :" << std::endl;
+
+    constexpr auto op = NTerm(cs<"op">()); // any operator
+    constexpr auto ruleset = nested_lists_grammar();
+
+    using VStr = StdStr<char>;
+    using TokenType = StdStr<char>;
+
+    auto lexer = make_lexer<VStr, TokenType>(ruleset, mk_lexer_conf<LexerConfEnum::AdvancedLexer, LexerConfEnum::HandleDuplicates>());
+    auto parser = make_sr_parser<VStr, TokenType, TreeNode<VStr>>(ruleset, lexer, mk_sr_parser_conf<SRConfEnum::Lookahead>());
+
+    // Each window over the opening brackets has the common type array, the cache should grow linearly with the depth
+    constexpr std::size_t depth = 1000;
+    VStr nested("a");
+    for (std::size_t i = 0; i < depth; i++) nested = VStr("[") + nested + VStr("]");
+
+    bool ok;
+    auto tokens = lexer.run(nested, ok);
+    TreeNode<VStr> tree;
+    auto session = parser.make_session();
+    ok = ok && parser.run(tree, op, tokens, session);
+    std::cout << "stored windows : " << session.intersect_cache.peak() << std::endl;
+    if (!ok || session.intersect_cache.peak() > 4 * depth)
+    {
+        std::cout << "intersections cache error" << std::endl;
+        return false;
+    }
+    return true;
+}
+
 bool test_gbnf()
 {
-    return test_gbnf_basic() && test_gbnf_complex1() && test_gbnf_extended() && test_gbnf_parse_1() && test_gbnf_parse_calc() && test_sr_init() && test_sr_calc() && test_adv_lexer() && test_terms_range() && test_heuristic_ctx_init();
+    return test_gbnf_basic() && test_gbnf_complex1() && test_gbnf_extended() && test_gbnf_parse_1() && test_gbnf_parse_calc() && test_sr_init() && test_sr_calc() && test_adv_lexer() && test_terms_range() && test_heuristic_ctx_init() && test_dfa_lexer() && test_str_view() && test_symbol_id() && test_flat_tree() && test_lazy_automaton() && test_lr_parser() && test_parse_session() && test_parse_batch() && test_stream_parser() && test_tree_builder() && test_mapped_input() && test_stream_lexer() && test_parallel_lexer() && test_byte_runs() && test_coalesce_runs() && test_range_lookup() && test_rule_bounds() && test_handle_automaton() && test_follow_matrix() && test_shift_only() && test_intersect_cache();
 }
 
 #endif //SUPERCFG_BNF_H